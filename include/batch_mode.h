@@ -1,18 +1,28 @@
 #ifndef BATCH_MODE_H
 #define BATCH_MODE_H
 
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #include "command_return_list.h"
 #include "debug.h"
 #include "executor.h"
 #include "globals.h"
+#include "parse_script.h"
+#include "reaper.h"
 #include "readline.h"
-#include "signals.h"
+#include "session.h"
 #include "string_list.h"
 
-int batch_mode_run(char *filename, string_list *bin_list, char **env_list);
+int batch_mode_run(char *filename, string_list *bin_list);
+
+int batch_mode_run_fd(int fd, string_list *bin_list);
+
+int batch_mode_run_string(char *commands, string_list *bin_list);
+
+int batch_mode_replay(session_replay *replay, string_list *bin_list);
 
 #endif
@@ -0,0 +1,69 @@
+#ifndef COMMAND_INDEX_H
+#define COMMAND_INDEX_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pwd.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "globals.h"
+#include "io.h"
+#include "string_list.h"
+
+/**
+ * On-disk index of every command name in the $PATH dirs, shared by all smash processes through a read-only mmap,
+ * so that a new shell finds its commands without reading a single directory.
+ *
+ * There's one index file per $PATH, under ~/.cache/smash. It records each dir's identity & mtime;
+ * whichever process first sees that one has changed rebuilds the index into a temporary file & renames it into place.
+ *
+ * Layout: header, then dirs[num_dirs], buckets[num_buckets], entries[num_entries], & the NUL terminated strings.
+ * Each bucket holds an entry's index + 1 (0 is empty); collisions probe the following buckets.
+ */
+
+#define COMMAND_INDEX_MAGIC "SMASHIDX"
+#define COMMAND_INDEX_VERSION 1
+#define COMMAND_INDEX_DIR ".cache/smash"
+
+/** the command isn't in any of the dirs */
+#define COMMAND_INDEX_NOT_FOUND -1
+
+/** there's no index to look in; the dirs must be searched instead */
+#define COMMAND_INDEX_UNAVAILABLE -2
+
+typedef struct command_index_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t size;  // of the whole file
+
+    uint32_t num_dirs;
+    uint32_t num_buckets;  // a power of 2
+    uint32_t num_entries;
+    uint32_t path_offset;  // the $PATH it was built for, within the strings
+} command_index_header;
+
+typedef struct command_index_dir {
+    uint64_t dev;
+    uint64_t ino;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+} command_index_dir;
+
+typedef struct command_index_entry {
+    uint32_t hash;
+    uint32_t name_offset;
+    uint32_t dir;  // index of its dir in $PATH
+} command_index_entry;
+
+int command_index_find(char *name, string_list *bin_list);
+
+void command_index_close(void);
+
+#endif
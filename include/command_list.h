@@ -1,11 +1,25 @@
 #ifndef COMMAND_LIST_H
 #define COMMAND_LIST_H
 
-char *COMMAND_EXIT = "exit";
-char *COMMAND_CD = "cd";
-char *COMMAND_PWD = "pwd";
-char *COMMAND_ECHO = "echo";
-char *COMMAND_JOBS = "jobs";
-char *COMMAND_HISTORY = "history";
+static char *COMMAND_EXIT = "exit";
+static char *COMMAND_CD = "cd";
+static char *COMMAND_PWD = "pwd";
+static char *COMMAND_ECHO = "echo";
+static char *COMMAND_JOBS = "jobs";
+static char *COMMAND_HISTORY = "history";
+static char *COMMAND_BREAK = "break";
+static char *COMMAND_CONTINUE = "continue";
+static char *COMMAND_RETURN = "return";
+static char *COMMAND_EXEC = "exec";
+static char *COMMAND_ULIMIT = "ulimit";
+static char *COMMAND_EXPORT = "export";
+static char *COMMAND_UNSET = "unset";
+static char *COMMAND_PARALLEL = "parallel";
+static char *COMMAND_TIMEOUT = "timeout";
+
+/** the commands handled by the shell itself, for completion */
+static char **COMMAND_BUILTINS[] = {&COMMAND_EXIT, &COMMAND_CD, &COMMAND_PWD, &COMMAND_HISTORY, &COMMAND_BREAK,
+                                    &COMMAND_CONTINUE, &COMMAND_RETURN, &COMMAND_EXEC, &COMMAND_ULIMIT,
+                                    &COMMAND_EXPORT, &COMMAND_UNSET, &COMMAND_PARALLEL, &COMMAND_TIMEOUT, NULL};
 
 #endif
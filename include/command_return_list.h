@@ -6,6 +6,9 @@
 #define COMMAND_RETURN_EXIT 2
 #define COMMAND_RETURN_RETRY 3
 #define COMMAND_RETURN_EXEC_ERR 4
+#define COMMAND_RETURN_BREAK 5
+#define COMMAND_RETURN_CONTINUE 6
+#define COMMAND_RETURN_FUNCTION_RETURN 7
 
 #define COMMAND_RETURN_NOT_FOUND 127
 #define COMMAND_RETURN_INTERNAL_CMD 254
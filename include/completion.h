@@ -0,0 +1,38 @@
+#ifndef COMPLETION_H
+#define COMPLETION_H
+
+#include <ctype.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "command_list.h"
+#include "debug.h"
+#include "globals.h"
+#include "io.h"
+#include "string_list.h"
+
+/**
+ * Tab completion. The first word of a line completes from a sorted index of every builtin & every
+ * name in the $PATH dirs, & any other word completes as a filename; both come from the cached
+ * listings in io.h, so a Tab press only costs a stat() of each directory it looks in.
+ */
+
+typedef struct completion {
+    int start;  // offset in the line of the word being completed
+    int base;   // offset in the line where the completed names begin, past the word's directory part
+    int command;  // 1 if completing a command name, 0 for a filename
+
+    io_dir_entry *matches;  // the matching names, sorted
+    int count;
+} completion;
+
+void completion_set_bin_list(string_list *bin_list);
+
+int completion_find(char *line, int len, int pos, completion *result);
+
+void completion_free(completion *result);
+
+#endif
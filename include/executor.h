@@ -4,6 +4,7 @@
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <malloc.h>
 #include <pwd.h>
 #include <signal.h>
 #include <stdio.h>
@@ -15,15 +16,31 @@
 #include <time.h>
 #include <unistd.h>
 
+#include "command_index.h"
 #include "command_return_list.h"
+#include "completion.h"
 #include "debug.h"
+#include "function_table.h"
 #include "globals.h"
+#include "internal_command/export.h"
 #include "internal_command/history.h"
+#include "internal_command/parallel.h"
 #include "internal_command/pwd.h"
+#include "internal_command/ulimit.h"
+#include "job_limits.h"
 #include "parse_command.h"
 #include "parse_path.h"
+#include "parse_script.h"
 #include "pointer_pointer_helper.h"
+#include "reaper.h"
 #include "string_list.h"
+#include "trace.h"
+
+/** finished jobs kept in the job list; older ones are freed as new jobs start */
+#define EXECUTOR_KEEP_FINISHED 64
+
+/** where a group keeps the stdin, stdout & stderr its redirects replace, out of the way of low fds */
+#define EXECUTOR_SAVED_FD_MIN 10
 
 typedef struct executor_jobs {
     commander *cmd;
@@ -36,7 +53,29 @@ typedef struct executor_jobs {
  */
 executor_jobs *executor_execd_head();
 
-int executor_exec_command(string_list *command, string_list *bin_list, char **envs_vars);
+int executor_exec_command(string_list *command, string_list *bin_list);
+
+void executor_exec_in_process(commander *cmd);
+
+void executor_exec_bin_command(commander *cmd, string_list *command);
+
+char **executor_build_argv(commander *cmd);
+
+char *executor_find_binary(char *command, string_list *bin_list);
+
+void executor_sync_bin_list(string_list *bin_list);
+
+void executor_set_tail_exec(int enabled);
+
+int executor_has_running_jobs();
+
+int executor_count_running_jobs();
+
+int executor_exec_script(script_node *node, string_list *bin_list);
+
+void executor_job_done(commander *cmd, int status, struct rusage *usage);
+
+int executor_wait_job(commander *cmd);
 
 int executor_init_execd();
 
@@ -46,6 +85,8 @@ int executor_push_execd(commander *cmd);
 
 executor_jobs *executor_newest_job();
 
+void executor_enable_mem_stats();
+
 void executor_debug_execd();
 
 #endif
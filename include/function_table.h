@@ -0,0 +1,38 @@
+#ifndef FUNCTION_TABLE_H
+#define FUNCTION_TABLE_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+#include "parse_script.h"
+
+/**
+ * Hash table of shell functions, `name() { ... }`, mapping each name to its already parsed body.
+ *
+ * Bodies are reference counted: the table holds one reference & each running call another, so a function
+ * that's redefined (or redefines itself) while it's running keeps walking its old body until the call returns.
+ */
+
+#define FUNCTION_TABLE_BUCKETS 64
+
+typedef struct function_body {
+    script_node *nodes;
+    int refs;
+} function_body;
+
+typedef struct function_entry {
+    char *name;
+    function_body *body;
+    struct function_entry *next;
+} function_entry;
+
+int function_table_set(char *name, script_node *body);
+
+function_entry *function_table_get(char *name);
+
+function_body *function_table_retain(function_entry *entry);
+
+void function_table_release(function_body *body);
+
+#endif
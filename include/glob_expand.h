@@ -0,0 +1,33 @@
+#ifndef GLOB_EXPAND_H
+#define GLOB_EXPAND_H
+
+#include <dirent.h>
+#include <fnmatch.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "debug.h"
+#include "globals.h"
+#include "io.h"
+#include "string_list.h"
+
+/**
+ * Pathname expansion of the arguments: `*`, `?` & `[...]` as in fnmatch(3), with a leading '.' only matched explicitly.
+ *
+ * Each component of a pattern is matched against the cached listing of its directory (see io.h), which is already
+ * sorted & only read again with getdents64 once the directory changes, so every directory a command line expands in
+ * is read at most once while it stays cached, & matches come out sorted. The literal start of a component narrows it to a binary searched
+ * range of the listing before any matching is done. Matches are pushed straight onto a string_list, so expanding
+ * even a huge directory costs a handful of allocations rather than one per name.
+ */
+
+#define GLOB_EXPAND_MAGIC "*?["
+
+int glob_expand_has_magic(char *word);
+
+int glob_expand(char *pattern, string_list *matches);
+
+#endif
@@ -1,7 +1,6 @@
 #ifndef GLOBALS_H
 #define GLOBALS_H
 
-#define MAX_PATH 128
 
 static char *SMASH_VERSION = "1.0.5";
 static char *ROOT_PATH = "/";
@@ -16,8 +15,23 @@ static const char *INPUT_REDIRECT_KEY = "<";
 static const char VARIABLE_START_KEY = '$';
 static const char NULL_CHAR = '\0';
 static char *LAST_RETURN_KEY = "$?";
-static char *PROMPT = "smash> ";
+static char *PROMPT = "\\w\nsmash> ";
+static char *ENV_PROMPT_KEY = "PS1";
 static char *DEBUG_FLAG = "-d";
+static char *COMMAND_STRING_FLAG = "-c";
+static char *STDIN_FLAG = "-s";
+static char *METRICS_FLAG = "--metrics";
+static char *RECORD_FLAG = "--record";
+static char *REPLAY_FLAG = "--replay";
+static char *PACE_FLAG = "--pace";
+static char *MEM_STATS_FLAG = "--mem-stats";
 static char *HISTORY_FILE = ".smash_history";
+static char *ENV_HISTSIZE_KEY = "HISTSIZE";
+static char *ENV_HISTFILESIZE_KEY = "HISTFILESIZE";
+static char *ENV_HISTCONTROL_KEY = "HISTCONTROL";
+static char *ENV_HISTSHARE_KEY = "HISTSHARE";
+static char *ENV_TRACE_KEY = "SMASH_TRACE";
+static char *ENV_JOB_OUTPUT_KEY = "SMASH_JOB_OUTPUT";
+static char *ENV_CMD_TIMEOUT_KEY = "SMASH_CMD_TIMEOUT";
 
 #endif
@@ -1,6 +1,7 @@
 #ifndef INTERACTIVE_MODE_H
 #define INTERACTIVE_MODE_H
 
+#include <pwd.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -9,10 +10,14 @@
 #include "debug.h"
 #include "executor.h"
 #include "globals.h"
+#include "internal_command/history.h"
+#include "line_editor.h"
+#include "reaper.h"
 #include "readline.h"
-#include "signals.h"
+#include "session.h"
 #include "string_list.h"
+#include "trace.h"
 
-int interactive_mode_run(int argc, char *argv[], string_list *bin_list, char **env_list);
+int interactive_mode_run(int argc, char *argv[], string_list *bin_list);
 
 #endif
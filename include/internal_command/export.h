@@ -0,0 +1,16 @@
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "globals.h"
+#include "parse_path.h"
+#include "string_list.h"
+
+int internal_command_export(string_list *command);
+
+int internal_command_unset(string_list *command);
+
+#endif
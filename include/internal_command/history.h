@@ -1,16 +1,53 @@
 #ifndef HISTORY_H
 #define HISTORY_H
 
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 #include <time.h>
+#include <unistd.h>
 
+#include "command_list.h"
+#include "debug.h"
+#include "globals.h"
+#include "parse_path.h"
 #include "readline.h"
 #include "string_list.h"
+#include "trace.h"
+
+/** how many of the most recent entries are kept in memory, unless $HISTSIZE says otherwise */
+#define HISTORY_SIZE_DEFAULT 1000
+
+/** $HISTCONTROL options */
+#define HISTORY_IGNORE_SPACE "ignorespace"
+#define HISTORY_IGNORE_DUPS "ignoredups"
+#define HISTORY_IGNORE_BOTH "ignoreboth"
+
+/** how much of the history file is read at a time, backwards from its end */
+#define HISTORY_READ_CHUNK 4096
+
+/** length of the 'YYYY-MM-DD HH:MM:SS $ ' prefix of every history file line */
+#define HISTORY_TIMESTAMP_LENGTH 22
 
 int internal_command_history(char *home_path, char *history_file);
 
-int internal_command_history_write(char *home_path, char *history_file, string_list *command);
+int internal_command_history_write(char *home_path, char *history_file, char *raw_cmd);
+
+int internal_command_history_load(char *home_path, char *history_file);
+
+int internal_command_history_sync(void);
+
+int internal_command_history_reap(void);
+
+int internal_command_history_count(void);
+
+char *internal_command_history_command(int index);
 
 #endif
@@ -0,0 +1,34 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "job_limits.h"
+#include "string_list.h"
+
+/**
+ * $ parallel [-j N] [-v] cmd args... ::: item...
+ * $ parallel [-j N] [-v] cmd args... < file
+ *
+ * Runs the command once per item, with each '{}' in its arguments replaced by the item (or the item appended when
+ * there's no '{}'). At most N jobs run at once, N being the number of online cpus by default;
+ * a new one is started as soon as the reaper sees one finish.
+ */
+
+#define PARALLEL_ITEMS_KEY ":::"
+#define PARALLEL_ITEM_KEY "{}"
+
+/** like xargs & GNU parallel, the exit status is the number of failed items, up to this */
+#define PARALLEL_MAX_FAILED 101
+
+typedef struct parallel_slot {
+    struct commander *cmd;  // NULL when the slot is free
+    char *item;
+} parallel_slot;
+
+int internal_command_parallel(string_list *command, string_list *bin_list, job_limits *limits);
+
+#endif
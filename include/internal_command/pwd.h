@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "command_return_list.h"
@@ -12,4 +13,8 @@
 
 int internal_command_pwd(void);
 
+int internal_command_pwd_update(void);
+
+char *internal_command_pwd_current(void);
+
 #endif
@@ -0,0 +1,13 @@
+#ifndef ULIMIT_H
+#define ULIMIT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "job_limits.h"
+#include "string_list.h"
+
+int internal_command_ulimit(string_list *command);
+
+#endif
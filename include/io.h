@@ -2,9 +2,56 @@
 #define IO_H
 
 #include <dirent.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "debug.h"
+
+/**
+ * Cached directory listings. A listing is read with getdents64 into one buffer, sorted by name,
+ * and only read again once the directory's mtime (or identity) changes.
+ *
+ * The cache is bounded: once it holds more than IO_DIR_MAX_CACHED listings or IO_DIR_MAX_NAMES names in all, the
+ * least recently listed are dropped. That's only done by io_dir_trim(), which each user of the listings (globbing,
+ * completion, the command index) calls before it starts, so no listing is ever freed while one is still using it.
+ */
+
+#define IO_DIR_BUCKETS 64
+#define IO_DIR_READ_SIZE 32768
+#define IO_DIR_MAX_CACHED 128
+#define IO_DIR_MAX_NAMES 131072
+
+typedef struct io_dir_entry {
+    char *name;
+    unsigned char type;  // the dirent d_type; DT_UNKNOWN if the filesystem doesn't say
+} io_dir_entry;
+
+typedef struct io_dir {
+    char *path;
+
+    dev_t dev;
+    ino_t ino;
+    struct timespec mtime;
+
+    char *names;             // every name, NUL separated, in a single allocation
+    io_dir_entry *entries;   // sorted by name, without '.' & '..'
+    int count;
+    unsigned long generation;  // changes whenever the listing is read again
+    unsigned long last_used;   // when it was last listed, for dropping the least recently used
+
+    struct io_dir *next;
+} io_dir;
+
+io_dir *io_dir_list(char *path);
+
+int io_dir_prefix(io_dir *dir, char *prefix, int *first);
+
+void io_dir_trim(void);
 
 void io_print_files_in_dir(char *path);
 
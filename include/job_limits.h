@@ -0,0 +1,61 @@
+#ifndef JOB_LIMITS_H
+#define JOB_LIMITS_H
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "string_list.h"
+
+/**
+ * Resource controls for jobs: rlimits, CPU affinity and scheduling priority.
+ *
+ * Per-job controls are given as prefixes of the command, e.g.) `@cpus=0-3 @nice=10 @nofile=256 cmd`.
+ * The same prefixes without a command (or the `ulimit` builtin) set shell-wide defaults for all later jobs.
+ * Both are applied in the child, just before it execs; the shell itself is never limited.
+ */
+
+#define JOB_LIMITS_MAX_CPUS 1024
+
+typedef struct job_limits {
+    int has_nice;
+    int nice;  // niceness increment, relative to the shell's own
+
+    int has_cpus;
+    unsigned char cpus[JOB_LIMITS_MAX_CPUS / 8];  // bitmask of allowed cpus
+
+    int has_rlimit[RLIMIT_NLIMITS];
+    struct rlimit rlimits[RLIMIT_NLIMITS];
+} job_limits;
+
+typedef struct job_limits_resource {
+    char flag;         // e.g.) 'n' for `ulimit -n`
+    char *name;        // e.g.) 'nofile' for the `@nofile=` prefix
+    int resource;      // e.g.) RLIMIT_NOFILE
+    rlim_t unit;       // multiplier from the user-given value to the rlimit value
+    char *description;
+} job_limits_resource;
+
+job_limits *job_limits_new();
+
+job_limits *job_limits_defaults();
+
+job_limits_resource *job_limits_resources();
+
+job_limits_resource *job_limits_resource_by_flag(char flag);
+
+int job_limits_set_rlimit(job_limits *limits, job_limits_resource *resource, char *value);
+
+int job_limits_parse_prefixes(string_list *command, job_limits **limits);
+
+void job_limits_set_defaults(job_limits *limits);
+
+void job_limits_apply(job_limits *limits);
+
+void job_limits_print(job_limits_resource *resource);
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef JOB_OUTPUT_H
+#define JOB_OUTPUT_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "parse_command.h"
+#include "parse_path.h"
+
+/**
+ * Multiplexed output of background jobs, turned on by `SMASH_JOB_OUTPUT=prefix`.
+ *
+ * Each background job's stdout & stderr are pipes instead of the terminal. The shell drains them through an epoll set
+ * (nested in the reaper's, so it's drained whenever the shell waits) & writes out each complete line with a '[job_id] '
+ * prefix, so lines of different jobs never interleave. The pipes are shrunk to JOB_OUTPUT_PIPE_SIZE & each stream
+ * buffers at most a line, so a job writing faster than the terminal can keep up is blocked rather than buffered.
+ * The shell never waits on exit for jobs still running; their streams are forwarded by a process of their own.
+ */
+
+#define JOB_OUTPUT_PREFIX "prefix"
+
+/** bytes a job can write ahead of the shell, per stream */
+#define JOB_OUTPUT_PIPE_SIZE 16384
+
+/** longer lines are written out in pieces of this size */
+#define JOB_OUTPUT_LINE_MAX 4096
+
+#define JOB_OUTPUT_MAX_EVENTS 16
+
+/** how long the shell waits on exit for more of the jobs' output, before leaving the rest to a forwarding process */
+#define JOB_OUTPUT_FINISH_WAIT_MS 20
+
+typedef struct job_output_stream {
+    int fd;         // read end of the pipe
+    int target;     // STDOUT_FILENO or STDERR_FILENO
+    int job_id;
+    int len;        // bytes of the partial line buffered
+    char line[JOB_OUTPUT_LINE_MAX];
+} job_output_stream;
+
+int job_output_init(void);
+
+int job_output_enabled(void);
+
+int job_output_open(commander *cmd);
+
+void job_output_redirect(commander *cmd);
+
+void job_output_close_writers(commander *cmd);
+
+void job_output_drain(void);
+
+void job_output_finish(void);
+
+#endif
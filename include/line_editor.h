@@ -0,0 +1,56 @@
+#ifndef LINE_EDITOR_H
+#define LINE_EDITOR_H
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "completion.h"
+#include "debug.h"
+#include "internal_command/history.h"
+#include "prompt.h"
+#include "readline.h"
+#include "trace.h"
+
+/**
+ * Raw-mode (termios) line editor for interactive input on a terminal.
+ *
+ * Keys: left/right, ^B/^F move a char; alt-b/alt-f move a word; home/end, ^A/^E; backspace, delete, ^D;
+ * ^K/^U kill to end/start of line, ^W kill the previous word, ^Y yank the last kill;
+ * up/down, ^P/^N recall history; tab completes, & a second tab lists the choices;
+ * ^L clear screen; ^C discard the line; ^D on an empty line ends input.
+ *
+ * Only the cells that changed are redrawn after a key, and each key's output is sent in a single write.
+ */
+
+typedef struct line_editor {
+    int fd;
+
+    char *buf;  // the line being edited; not NUL terminated
+    int len;
+    int size;
+    int pos;  // cursor, as an offset into buf
+
+    char *shown;  // what's currently drawn after the prompt
+    int shown_len;
+    int shown_size;
+    int shown_pos;  // where the terminal's cursor is, as an offset into shown
+
+    int history_index;  // how many entries back from the newest is being shown; 0 is the line being typed
+    char *scratch;      // the line being typed, put aside while browsing history
+
+    char *out;  // output batched up until the key has been handled
+    int out_len;
+    int out_size;
+} line_editor;
+
+/** how many choices a second tab lists at most */
+#define LINE_EDITOR_LIST_MAX 256
+
+char *line_editor_readline(char *prompt, int fd);
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "debug.h"
+
+/**
+ * Per-command metrics log, turned on by `--metrics FILE`. One record is written for every command run:
+ * as CSV if FILE ends in '.csv', otherwise as a line of JSON. Records are buffered & written out in large chunks.
+ */
+
+#define METRICS_BUFFER_SIZE 65536
+
+#define METRICS_KIND_BUILTIN "builtin"
+#define METRICS_KIND_FUNCTION "function"
+#define METRICS_KIND_EXTERNAL "external"
+
+/**
+ * What's known about a command while it runs; times are in nanoseconds.
+ */
+typedef struct metrics_timing {
+    char *command;  // the whole command line, or NULL when metrics are off
+    char *kind;     // one of METRICS_KIND_*, or NULL if nothing was run
+
+    struct timespec started;  // wall clock time it was started
+    long long start_ns;       // monotonic time it was started
+    long long parse_ns;       // parse_command_from_string_list()
+    long long lookup_ns;      // executor_find_binary()
+    long long spawn_ns;       // fork(), as seen by the shell
+} metrics_timing;
+
+int metrics_open(char *path);
+
+void metrics_reinit(void);
+
+int metrics_enabled(void);
+
+long long metrics_now(void);
+
+void metrics_start(metrics_timing *timing, char *command);
+
+void metrics_record(metrics_timing *timing, int exit_code, struct rusage *usage);
+
+void metrics_flush(void);
+
+#endif
@@ -7,9 +7,13 @@
 
 #include "debug.h"
 #include "globals.h"
+#include "glob_expand.h"
+#include "job_limits.h"
+#include "metrics.h"
 #include "parse_path.h"
 #include "pointer_pointer_helper.h"
 #include "string_list.h"
+#include "trace.h"
 
 static int jobs;
 
@@ -19,8 +23,15 @@ typedef struct commander {
     int bgfg;  // -1 = is foreground job, 1 is background job.
 
     pid_t pid;      // should only have non-zero pid if it's been started
+    int pidfd;      // pidfd watched by the reaper while running, otherwise -1
     int running;    // 1 = running, -1 = not running.
     int exit_code;  // exit code of this command after it finished running
+    long long timeout_ns;     // from a 'timeout' prefix or $SMASH_CMD_TIMEOUT; 0 for none
+    long long kill_after_ns;  // how long after SIGTERM to send SIGKILL; 0 for REAPER_KILL_AFTER_NS
+    int timerfd;              // armed with the job's deadline while it's running, otherwise -1
+    int timed_out;            // 1 once it's been sent SIGTERM for running too long
+
+    int output_fd[2];  // write ends of its stdout & stderr pipes until forked, when SMASH_JOB_OUTPUT multiplexes them; else -1
 
     time_t started;   // timestamp when started
     time_t finished;  // timestamp when finished
@@ -29,17 +40,30 @@ typedef struct commander {
 
     char *bin_dir;                // e.g.) '/usr/local/bin'
     char *bin;                    // e.g.) 'echo'
-    char **bin_params;            // e.g.) '-s -x'
+    char **bin_params;            // e.g.) '-s -x', the strings of params; NULL if there are none
     int num_bin_params;           // e.g.) '2' (need to keep track of size of param array above)
     char *output_redirect;        // e.g.) '>someOutput'
     char *output_error_redirect;  // e.g.) '2>somefile'
     char *input_redirect;         // e.g.) '<someInputFile'
+    string_list *params;          // owns the bytes of bin_params, after variables & patterns are expanded
+    char **argv;                  // e.g.) '/bin/echo -s -x', built in one block just before it's forked; otherwise NULL
+
+    job_limits *limits;  // e.g.) '@cpus=0-3 @nice=10' prefixes; NULL if the job has none
+
+    metrics_timing timing;  // for the --metrics record written once the job is reaped
+    long long trace_start;  // when it was forked, for the span on its SMASH_TRACE track
 } commander;
 
 string_list *parse_command_to_string_list(char *command);
 
 commander *parse_command_from_string_list(string_list *command);
 
+void parse_command_redirects(string_list *tokens, char **input_redirect, char **output_redirect, char **output_error_redirect);
+
+void parse_command_free(commander *cmd);
+
+size_t parse_command_size(commander *cmd);
+
 void parse_command_debug_commander(commander *cmd);
 
 #endif
@@ -1,6 +1,7 @@
 #ifndef PARSE_PATH_H
 #define PARSE_PATH_H
 
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -18,19 +19,40 @@
 
 typedef struct env_params {
     char *key;
-    char *value;
+    char *value;   // NULL if it's been exported but not given a value yet
+    int exported;  // 1 if it's passed on to commands
 } env_params;
 
-static env_params **env_variables;
-
 string_list *parse_path_bin_dirs(char *path_str);
 
-char **parse_path_all_env_params(char *envp[]);
+void parse_path_bin_dirs_into(string_list *bin_list, char *path_str);
+
+int parse_path_all_env_params(char *envp[]);
 
 void parse_path_debug_env_variables();
 
 char *parse_path_get_env(char *key);
 
+int parse_path_set_env(char *key, char *value);
+
+int parse_path_export_env(char *key, char *value);
+
+void parse_path_unset_env(char *key);
+
+string_list *parse_path_get_env_overrides(void);
+
+void parse_path_set_env_overrides(string_list *assignments);
+
+int parse_path_name_length(char *string);
+
+int parse_path_is_assignment(char *string);
+
+char **parse_path_envp(void);
+
+void parse_path_print_exported(void);
+
+string_list *parse_path_set_positional(string_list *params);
+
 int get_last_return_value();
 
 void set_last_return_value(int code);
@@ -0,0 +1,83 @@
+#ifndef PARSE_SCRIPT_H
+#define PARSE_SCRIPT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+#include "globals.h"
+#include "parse_command.h"
+#include "readline.h"
+#include "session.h"
+#include "string_list.h"
+
+/**
+ * Parses the lines of a script into a tree of script_node's once, so that the executor can walk
+ * loop and conditional bodies any number of times without re-reading or re-tokenizing them.
+ *
+ * Look in this file's relative .c file for the supported grammar.
+ */
+
+#define SCRIPT_NODE_COMMAND 0
+#define SCRIPT_NODE_IF 1
+#define SCRIPT_NODE_WHILE 2
+#define SCRIPT_NODE_FOR 3
+#define SCRIPT_NODE_FUNCTION 4
+#define SCRIPT_NODE_LIST 5
+#define SCRIPT_NODE_GROUP 6
+#define SCRIPT_NODE_SUBSHELL 7
+
+/** how a step of a list depends on the exit status of the step before it */
+#define SCRIPT_RUN_ALWAYS 0      // 'a ; b', or the first step
+#define SCRIPT_RUN_IF_SUCCESS 1  // 'a && b'
+#define SCRIPT_RUN_IF_FAILURE 2  // 'a || b'
+
+typedef struct script_node {
+    int type;  // one of SCRIPT_NODE_*
+
+    string_list *command;  // COMMAND: the tokenized command. FOR: the items to iterate over. GROUP/SUBSHELL: redirects, or NULL.
+    char *variable;        // FOR: name of the loop variable. FUNCTION: name of the function.
+
+    struct script_node *condition;  // IF/WHILE: list whose exit status decides the branch.
+    struct script_node *body;       // IF: 'then' branch. WHILE/FOR: loop body. FUNCTION: function body. LIST: the steps. GROUP/SUBSHELL: the commands.
+    struct script_node *else_body;  // IF: 'else' branch ('elif' is a nested IF), or NULL.
+
+    int run_if;                // one of SCRIPT_RUN_*; whether it's skipped depends on the node before it.
+
+    struct script_node *next;  // next node in the same list, or NULL.
+} script_node;
+
+/**
+ * Supplies lines in place of reading them from the reader's fd; returns a new string, or NULL when there are no more.
+ */
+typedef char *script_line_source(void *data);
+
+typedef struct script_reader {
+    int fd;
+    char *prompt;
+
+    script_line_source *source;  // where lines come from instead of fd, e.g.) a replayed session; or NULL
+    void *source_data;
+    readline_buffer *input;  // buffered reading of fd, when there's no prompt to draw
+
+    string_list *pending;  // rest of a statement that followed a keyword, e.g.) 'then echo hi'
+    string_list *line;     // tokens of the line being split into statements, or NULL
+    int line_next;         // index in line of the next statement
+    int connector;         // SCRIPT_RUN_* joining the last statement taken to the one after it
+    int error;             // 1 once a syntax error has been reported.
+} script_reader;
+
+script_reader *parse_script_reader_new(int fd, char *prompt);
+
+void parse_script_reader_free(script_reader *reader);
+
+script_node *parse_script_next(script_reader *reader);
+
+script_node *parse_script_copy(script_node *node);
+
+void parse_script_free(script_node *node);
+
+void parse_script_debug(script_node *node, int depth);
+
+#endif
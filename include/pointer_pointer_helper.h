@@ -6,10 +6,31 @@
 
 #include "debug.h"
 
+/**
+ * Builds a NULL terminated array of strings, e.g.) an argv or envp, as a single allocation:
+ * the pointers followed by the bytes of every string, so the whole array is freed with one free().
+ *
+ * Each entry is made of up to three parts joined together, e.g.) a dir, '/' and a binary name.
+ * Size every entry first with pointer_pointer_block_size(), then pointer_pointer_block_alloc(),
+ * then add the same entries in the same order with pointer_pointer_block_add().
+ */
+typedef struct pointer_pointer_block {
+    int num;       // entries sized, then entries added
+    size_t bytes;  // of the strings, including their terminators
+    char **array;  // NULL until allocated
+    char *next;    // where the next entry's string goes
+} pointer_pointer_block;
+
 void pointer_pointer_debug(char **array, int length);
 
 char **pointer_pointer_merge(char **ptr1, int len1, char **ptr2, int len2);
 
 char **pointer_pointer_dup(char **array);
 
+void pointer_pointer_block_size(pointer_pointer_block *block, const char *part1, const char *part2, const char *part3);
+
+char **pointer_pointer_block_alloc(pointer_pointer_block *block);
+
+void pointer_pointer_block_add(pointer_pointer_block *block, const char *part1, const char *part2, const char *part3);
+
 #endif
@@ -0,0 +1,39 @@
+#ifndef PROMPT_H
+#define PROMPT_H
+
+#include <pwd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "globals.h"
+#include "internal_command/pwd.h"
+
+/**
+ * PS1-style prompt templates. A template is compiled once into segments, then re-rendered into a reused buffer.
+ *
+ * Escapes: \w cwd, \W basename of cwd, \? last exit status, \j running jobs,
+ * \t time (HH:MM:SS), \u user, \h host, \$ '#' for root otherwise '$', \n newline, \\ backslash.
+ */
+
+#define PROMPT_SEGMENT_TEXT 0
+#define PROMPT_SEGMENT_CWD 1
+#define PROMPT_SEGMENT_CWD_BASENAME 2
+#define PROMPT_SEGMENT_EXIT_STATUS 3
+#define PROMPT_SEGMENT_JOBS 4
+#define PROMPT_SEGMENT_TIME 5
+
+typedef struct prompt_segment {
+    int type;    // one of PROMPT_SEGMENT_*
+    char *text;  // TEXT: the literal text (escapes resolved once at compile time, e.g. \u)
+    size_t len;
+} prompt_segment;
+
+char *prompt_template();
+
+char *prompt_render(char *template);
+
+#endif
@@ -5,16 +5,44 @@
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <unistd.h>
 
 #include "debug.h"
-#include "signals.h"
+#include "prompt.h"
+#include "trace.h"
 
-typedef int readline_sig_hook(void);
+/**
+ * Blocks until the fd has input to read; returns 1 once it has, or -1 on error.
+ */
+typedef int readline_wait_hook(int fd);
 
-void readline_set_sig_hook(readline_sig_hook hook);
+/** how much non-interactive input is read at a time */
+#define READLINE_BUFFER_SIZE 65536
+
+/**
+ * Buffered input for scripts, pipes & the like, where no prompt is drawn and nothing is edited:
+ * lines are split out of large reads, rather than read a byte at a time.
+ */
+typedef struct readline_buffer {
+    int fd;
+
+    char *buf;
+    int size;
+    int start;  // where the next line begins
+    int end;    // end of what's been read
+    int eof;    // 1 once the fd has no more to give
+} readline_buffer;
+
+void readline_set_wait_hook(readline_wait_hook hook);
+
+int readline_wait(int fd);
 
 char *readline(char *prompt, int fd);
 
+readline_buffer *readline_buffer_new(int fd);
+
+char *readline_buffered(readline_buffer *in);
+
 #endif
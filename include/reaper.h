@@ -0,0 +1,64 @@
+#ifndef REAPER_H
+#define REAPER_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "job_output.h"
+#include "parse_command.h"
+#include "trace.h"
+
+/**
+ * Reaps finished jobs through pidfds (one per running job) registered in an epoll set owned by the main loop.
+ * Each pidfd's epoll data points straight at its job, so a completion never requires scanning the job list.
+ *
+ * readline() waits through reaper_wait_readable(), so input and child completions are multiplexed on one epoll_wait().
+ * The set of background jobs' output pipes is nested in it too, so their output is drained whenever the shell waits.
+ *
+ * A job with a time limit also has a timerfd in the set, with the same epoll data as its pidfd. When it expires,
+ * the job's process group is sent SIGTERM, then SIGKILL if it's still running REAPER_KILL_AFTER_NS later.
+ */
+
+#define REAPER_MAX_EVENTS 16
+
+#define REAPER_KILL_AFTER_NS 2000000000LL
+
+/** exit status of a job that ran out of time, as for coreutils' timeout */
+#define REAPER_TIMEOUT_EXIT 124
+
+int reaper_init();
+
+int reaper_reinit();
+
+int reaper_watch(commander *cmd);
+
+void reaper_unwatch(commander *cmd);
+
+long long reaper_parse_duration(char *duration);
+
+long long reaper_default_timeout();
+
+int reaper_set_timeout(commander *cmd);
+
+int reaper_poll();
+
+int reaper_wait_job(commander *cmd);
+
+int reaper_wait_any();
+
+int reaper_wait_readable(int fd);
+
+#endif
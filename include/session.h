@@ -0,0 +1,63 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "internal_command/pwd.h"
+#include "parse_path.h"
+
+/**
+ * Session recording (`--record FILE`) & replay (`--replay FILE`), so that real sessions can be re-run as benchmarks.
+ *
+ * A recording is a text file of one entry per line, with '\' & newlines escaped:
+ *
+ *   smash-session 1
+ *   cwd /home/me              the working directory; again whenever it changes
+ *   env PATH=/usr/bin:/bin    the environment the session began with, one entry per variable
+ *   line 1520301 ls -l        each input line, after how many microseconds into the session it was entered
+ */
+
+#define SESSION_MAGIC "smash-session 1"
+
+#define SESSION_ENTRY_CWD "cwd "
+#define SESSION_ENTRY_ENV "env "
+#define SESSION_ENTRY_LINE "line "
+
+typedef struct session_replay {
+    FILE *file;
+    int paced;  // 1 to wait out the recorded time between lines, 0 to run them back to back
+
+    char *cwd;    // working directory the session began in
+    char **env;   // environment the session began with; NULL terminated
+    int env_len;
+
+    char *entry;  // the last entry read
+    size_t entry_size;
+    int pending;  // 1 if the entry has been read but not yet handled, e.g.) the first line after the header
+
+    long long started_us;   // when the replay began
+    long long recorded_us;  // when the last line was entered in the recorded session
+
+    int lines;           // lines replayed so far
+    int cwd_mismatches;  // times the working directory differed from the recording
+} session_replay;
+
+int session_record_open(char *path);
+
+void session_record_line(char *line);
+
+session_replay *session_replay_open(char *path, int paced);
+
+char *session_replay_next(void *replay);
+
+void session_replay_report(session_replay *replay);
+
+#endif
@@ -7,26 +7,48 @@
 
 #include "debug.h"
 
+#define STRING_LIST_INITIAL_CAPACITY 8
+#define STRING_LIST_INITIAL_CHARS 64
+
 /**
  * String list structure - holds the size of the string and it's related string[] array.
+ *
+ * A growable vector: the bytes of every string are stored back to back in one buffer, at the offsets given,
+ * and both the buffer & the arrays double in capacity when they're full, so a push is amortized O(1).
+ * strings[i] always points at the i'th string in the buffer; they're re-pointed whenever the buffer moves,
+ * so they're only good until the next push.
+ *
+ * A view of another list's strings (e.g. its tokens past some prefixes) only needs size & strings,
+ * and must never be pushed to or freed.
  */
 typedef struct string_list {
     int size;
     char **strings;
+
+    int capacity;     // slots in strings & offsets
+    size_t *offsets;  // of each string within chars
+
+    char *chars;
+    size_t chars_used;
+    size_t chars_capacity;
 } string_list;
 
 string_list *string_list_new();
 
-int string_list_direct_insert(string_list *list, int index, char *string);
-
 string_list *string_list_from(char *string);
 
 void string_list_push(string_list *list, char *string);
 
+void string_list_push_len(string_list *list, const char *string, size_t len);
+
+void string_list_pop(string_list *list);
+
 string_list *string_list_from_delim(char *string, char *delim);
 
 char *string_list_string(string_list *list);
 
+void string_list_free(string_list *list);
+
 void string_list_debug(string_list *list);
 
 #endif
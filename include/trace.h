@@ -0,0 +1,51 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "debug.h"
+
+/**
+ * Timeline of what the shell is doing, turned on by `SMASH_TRACE=file.json`. Written in the Chrome trace event format,
+ * so it opens in chrome://tracing or ui.perfetto.dev.
+ *
+ * Everything the shell itself does (waiting for input, lexing, parsing, lookups, history, forking, waiting on jobs)
+ * is on the shell's track; every job gets a track of its own, named after its command, spanning its whole lifetime.
+ * Events are buffered & written out in large chunks, as for --metrics.
+ */
+
+#define TRACE_BUFFER_SIZE 65536
+
+/** names of the spans */
+#define TRACE_READLINE "readline"
+#define TRACE_LEX "lex"
+#define TRACE_PARSE "parse"
+#define TRACE_LOOKUP "lookup"
+#define TRACE_HISTORY "history"
+#define TRACE_COMMAND "command"
+#define TRACE_FORK "fork"
+#define TRACE_EXEC "exec"
+#define TRACE_WAIT "wait"
+
+int trace_open(char *path);
+
+int trace_enabled(void);
+
+long long trace_begin(void);
+
+int trace_shell_track(void);
+
+void trace_track(int track, char *name);
+
+void trace_span(int track, char *name, char *detail, long long begin);
+
+void trace_end(char *name, char *detail, long long begin);
+
+void trace_flush(void);
+
+#endif
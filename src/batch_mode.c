@@ -1,48 +1,147 @@
 #include "batch_mode.h"
 
-int batch_mode_run(char *filename, string_list *bin_list, char **env_list) {
-    char *input_line = NULL;
-    FILE *in_file = NULL;
-
-    if ((in_file = fopen(filename, "r")) == NULL) {
-        fprintf(stderr, "error: unable to open file for reading\n");
-        return 1;
-    }
+/**
+ * Run everything the reader has to offer, then free the reader.
+ * With tail_exec_ok, the final command may replace the shell, so nothing is left to do afterwards.
+ */
+int __batch_mode_run_reader(script_reader *reader, string_list *bin_list, int tail_exec_ok) {
+    script_node *node = NULL;
+    int ret;
 
     /**
-     * Read in a line of text
+     * Parse the next complete command (a compound command is read through to its closing keyword),
+     * then walk it. Loop bodies are run straight from the parsed tree.
+     *
+     * One node of look-ahead tells when the final command is about to run: if it's a plain command,
+     * it may be exec'd in place of the shell rather than forked & waited on.
+     * Without tail-exec there's no look-ahead, so a line is never read (or waited for) before the one ahead of it has run.
      */
-    while ((input_line = readline(PROMPT, fileno(in_file))) != NULL) {
-        string_list *cmd = NULL;
-        int executor_ret;
+    node = parse_script_next(reader);
 
-        debug("input read: '%s'\n", input_line);
+    while (node != NULL) {
+        script_node *next = tail_exec_ok ? parse_script_next(reader) : NULL;
+        int executor_ret;
 
-        if ((cmd = parse_command_to_string_list(strdup(input_line))) == NULL) {
-            continue;
-        }
+        executor_set_tail_exec(tail_exec_ok && next == NULL && reader->error == 0 && node->type == SCRIPT_NODE_COMMAND);
+        executor_ret = executor_exec_script(node, bin_list);
 
-        /** Debug */
-        string_list_debug(cmd);
+        parse_script_free(node);
 
         /** Check output of executor */
-        if ((executor_ret = executor_exec_command(cmd, bin_list, env_list)) == COMMAND_RETURN_EXIT) {
+        if (executor_ret == COMMAND_RETURN_EXIT) {
+            parse_script_free(next);
+            parse_script_reader_free(reader);
             return 0;
-        } else if (executor_ret == COMMAND_RETURN_RETRY) {
-            /** error should be given by executor */
-            continue;
-        } else if (executor_ret == COMMAND_RETURN_NOT_FOUND) {
-            fprintf(stderr, "smash: command not found: %s\n", cmd->strings[0]);
-            continue;
-        } else if (executor_ret == COMMAND_RETURN_COMMENT) {
-            continue;
-        } else if (executor_ret == COMMAND_RETURN_INTERNAL_CMD) {
-            debug("finished executing internal command\n");
-            continue;
-        } else {
-            continue;
         }
+
+        node = tail_exec_ok ? next : parse_script_next(reader);
+    }
+
+    /** a script that ran to its end exits with the status of its last command */
+    ret = reader->error == 1 ? 1 : get_last_return_value();
+
+    parse_script_reader_free(reader);
+
+    return ret;
+}
+
+/**
+ * Run a script read from fd, e.g.) a pipe into stdin. No prompt is drawn, & the input is read in large chunks.
+ */
+int batch_mode_run_fd(int fd, string_list *bin_list) {
+    script_reader *reader = NULL;
+    struct stat st;
+
+    if ((reader = parse_script_reader_new(fd, NULL)) == NULL) {
+        fprintf(stderr, "error: unable to create script reader\n");
+        return 1;
     }
 
-    return 1;
+    /**
+     * Looking ahead for tail-exec means reading the next line before running this one, which only a regular file
+     * has ready; from a pipe, each command would wait on whatever's producing the next line.
+     */
+    return __batch_mode_run_reader(reader, bin_list, fstat(fd, &st) == 0 && S_ISREG(st.st_mode));
+}
+
+int batch_mode_run(char *filename, string_list *bin_list) {
+    int fd;
+    int ret;
+
+    if ((fd = open(filename, O_RDONLY | O_CLOEXEC)) == -1) {
+        fprintf(stderr, "error: unable to open file for reading\n");
+        return 1;
+    }
+
+    ret = batch_mode_run_fd(fd, bin_list);
+    close(fd);
+
+    return ret;
+}
+
+/**
+ * Split the next line off what's left of a `-c` string.
+ */
+char *__batch_mode_next_string(void *data) {
+    char **rest = data;
+    char *newline = NULL;
+    char *line = NULL;
+
+    if (*rest == NULL) {
+        return NULL;
+    }
+
+    if ((newline = strchr(*rest, '\n')) == NULL) {
+        line = strdup(*rest);
+        *rest = NULL;
+
+        return line;
+    }
+
+    line = strndup(*rest, newline - *rest);
+    *rest = newline + 1;
+
+    return line;
+}
+
+/**
+ * $ smash -c 'commands' - run the lines of the string as a script.
+ */
+int batch_mode_run_string(char *commands, string_list *bin_list) {
+    script_reader *reader = NULL;
+    char *rest = commands;
+
+    if ((reader = parse_script_reader_new(-1, NULL)) == NULL) {
+        fprintf(stderr, "error: unable to create script reader\n");
+        return 1;
+    }
+
+    reader->source = __batch_mode_next_string;
+    reader->source_data = &rest;
+
+    return __batch_mode_run_reader(reader, bin_list, 1);
+}
+
+/**
+ * Re-run a recorded session as a script, then report how long it took.
+ * Lines come straight from the recording (no prompts are drawn), and the last command is never exec'd,
+ * so that the report can be printed.
+ */
+int batch_mode_replay(session_replay *replay, string_list *bin_list) {
+    script_reader *reader = NULL;
+    int ret;
+
+    if ((reader = parse_script_reader_new(-1, NULL)) == NULL) {
+        fprintf(stderr, "error: unable to create script reader\n");
+        return 1;
+    }
+
+    reader->source = session_replay_next;
+    reader->source_data = replay;
+
+    ret = __batch_mode_run_reader(reader, bin_list, 0);
+
+    session_replay_report(replay);
+
+    return ret;
 }
@@ -0,0 +1,431 @@
+#include "command_index.h"
+
+/** the $PATH dirs the index is open for */
+static string_list *index_bin_list;
+static char *index_path_string;  // the dirs joined by ':'
+static char *index_file;
+
+static command_index_header *index_map;
+static size_t index_size;
+static size_t index_strings_size;  // of the strings section, the rest of the file
+
+uint32_t __command_index_hash(char *name) {
+    uint32_t hash = 2166136261u;
+
+    for (unsigned char *c = (unsigned char *)name; *c != '\0'; c++) {
+        hash = (hash ^ *c) * 16777619u;
+    }
+
+    return hash;
+}
+
+command_index_dir *__command_index_dirs(command_index_header *header) {
+    return (command_index_dir *)(header + 1);
+}
+
+uint32_t *__command_index_buckets(command_index_header *header) {
+    return (uint32_t *)(__command_index_dirs(header) + header->num_dirs);
+}
+
+command_index_entry *__command_index_entries(command_index_header *header) {
+    return (command_index_entry *)(__command_index_buckets(header) + header->num_buckets);
+}
+
+char *__command_index_strings(command_index_header *header) {
+    return (char *)(__command_index_entries(header) + header->num_entries);
+}
+
+/**
+ * Fill in a dir's record from its current state; a dir that doesn't exist is all zeros.
+ */
+void __command_index_stat(char *path, command_index_dir *dir) {
+    struct stat st;
+
+    memset(dir, 0, sizeof(command_index_dir));
+
+    if (stat(path, &st) == 0) {
+        dir->dev = st.st_dev;
+        dir->ino = st.st_ino;
+        dir->mtime_sec = st.st_mtim.tv_sec;
+        dir->mtime_nsec = st.st_mtim.tv_nsec;
+    }
+}
+
+/**
+ * Whether every dir is just as it was when the index was built.
+ */
+int __command_index_fresh(void) {
+    command_index_dir *dirs = __command_index_dirs(index_map);
+    command_index_dir current;
+
+    for (int i = 0; i < index_bin_list->size; i++) {
+        __command_index_stat(index_bin_list->strings[i], &current);
+
+        if (memcmp(&current, &dirs[i], sizeof(command_index_dir)) != 0) {
+            debug("command index is stale: '%s' has changed\n", index_bin_list->strings[i]);
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+void __command_index_unmap(void) {
+    if (index_map != NULL) {
+        munmap(index_map, index_size);
+        index_map = NULL;
+    }
+}
+
+/**
+ * Whether the sections the header describes fit in the file, in order, with the strings last.
+ * The entries are only checked as they're looked up, so mapping a large index costs nothing more.
+ */
+int __command_index_valid(command_index_header *header, size_t size) {
+    uint64_t strings_start = sizeof(command_index_header) + (uint64_t)header->num_dirs * sizeof(command_index_dir) +
+                             (uint64_t)header->num_buckets * sizeof(uint32_t) +
+                             (uint64_t)header->num_entries * sizeof(command_index_entry);
+
+    if (header->num_buckets == 0 || (header->num_buckets & (header->num_buckets - 1)) != 0) {
+        return 0;
+    }
+
+    return header->size == size && strings_start < size && header->path_offset < size - strings_start &&
+           ((char *)header)[size - 1] == '\0';
+}
+
+/**
+ * Map the index file, if there is one & it was built for these dirs.
+ * Another user's or a corrupt file is never trusted beyond what its header says fits in it.
+ *
+ * @returns 0, or -1 if it's missing or unusable
+ */
+int __command_index_map(void) {
+    command_index_header *header = NULL;
+    struct stat st;
+    int fd;
+
+    __command_index_unmap();
+
+    if ((fd = open(index_file, O_RDONLY | O_CLOEXEC)) == -1) {
+        return -1;
+    }
+
+    if (fstat(fd, &st) != 0 || st.st_size < sizeof(command_index_header) ||
+        (header = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+
+    close(fd);
+
+    index_map = header;
+    index_size = st.st_size;
+
+    if (memcmp(header->magic, COMMAND_INDEX_MAGIC, sizeof(header->magic)) != 0 || header->version != COMMAND_INDEX_VERSION ||
+        header->num_dirs != index_bin_list->size || !__command_index_valid(header, st.st_size) ||
+        strcmp(__command_index_strings(header) + header->path_offset, index_path_string) != 0) {
+        debug("command index '%s' doesn't match $PATH\n", index_file);
+        __command_index_unmap();
+
+        return -1;
+    }
+
+    index_strings_size = (char *)header + st.st_size - __command_index_strings(header);
+
+    return 0;
+}
+
+/**
+ * Read every dir & write a new index, renaming it over the old one so that no other process sees it half written.
+ * Where a name is in several dirs, the first in $PATH wins, as it would in a search.
+ *
+ * @returns 0, or -1 on error
+ */
+int __command_index_build(void) {
+    command_index_header header;
+    command_index_dir *dirs = NULL;
+    command_index_entry *entries = NULL;
+    uint32_t *buckets = NULL;
+    char *strings = NULL;
+    io_dir *listings[index_bin_list->size];
+    uint32_t num_names = 0;
+    uint32_t strings_len = 0;
+    char *tmp_file = NULL;
+    int ret = -1;
+    int fd;
+
+    io_dir_trim();
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, COMMAND_INDEX_MAGIC, sizeof(header.magic));
+    header.version = COMMAND_INDEX_VERSION;
+    header.num_dirs = index_bin_list->size;
+    header.num_buckets = 16;
+
+    strings_len = strlen(index_path_string) + 1;
+
+    for (int i = 0; i < index_bin_list->size; i++) {
+        if ((listings[i] = io_dir_list(index_bin_list->strings[i])) == NULL) {
+            continue;
+        }
+
+        num_names += listings[i]->count;
+
+        for (int j = 0; j < listings[i]->count; j++) {
+            strings_len += strlen(listings[i]->entries[j].name) + 1;
+        }
+    }
+
+    /** no more than half full, so probes stay short */
+    while (header.num_buckets < num_names * 2) {
+        header.num_buckets <<= 1;
+    }
+
+    dirs = calloc(header.num_dirs, sizeof(command_index_dir));
+    buckets = calloc(header.num_buckets, sizeof(uint32_t));
+    entries = malloc((num_names + 1) * sizeof(command_index_entry));
+    strings = malloc(strings_len);
+
+    if (dirs == NULL || buckets == NULL || entries == NULL || strings == NULL) {
+        debug("error: unable to allocate space for the command index\n");
+        goto done;
+    }
+
+    strcpy(strings, index_path_string);
+    header.path_offset = 0;
+    strings_len = strlen(index_path_string) + 1;
+
+    for (int i = 0; i < index_bin_list->size; i++) {
+        /** one that can't be read has no commands, but is still only rebuilt for once it changes */
+        if (listings[i] == NULL) {
+            __command_index_stat(index_bin_list->strings[i], &dirs[i]);
+            continue;
+        }
+
+        dirs[i].dev = listings[i]->dev;
+        dirs[i].ino = listings[i]->ino;
+        dirs[i].mtime_sec = listings[i]->mtime.tv_sec;
+        dirs[i].mtime_nsec = listings[i]->mtime.tv_nsec;
+
+        for (int j = 0; j < listings[i]->count; j++) {
+            char *name = listings[i]->entries[j].name;
+            uint32_t hash = __command_index_hash(name);
+            uint32_t b = hash & (header.num_buckets - 1);
+
+            while (buckets[b] != 0 && strcmp(strings + entries[buckets[b] - 1].name_offset, name) != 0) {
+                b = (b + 1) & (header.num_buckets - 1);
+            }
+
+            /** already found in an earlier dir */
+            if (buckets[b] != 0) {
+                continue;
+            }
+
+            entries[header.num_entries].hash = hash;
+            entries[header.num_entries].name_offset = strings_len;
+            entries[header.num_entries].dir = i;
+            buckets[b] = ++header.num_entries;
+
+            strcpy(strings + strings_len, name);
+            strings_len += strlen(name) + 1;
+        }
+    }
+
+    header.size = sizeof(header) + header.num_dirs * sizeof(command_index_dir) + header.num_buckets * sizeof(uint32_t) +
+                  header.num_entries * sizeof(command_index_entry) + strings_len;
+
+    if ((tmp_file = malloc(strlen(index_file) + 32)) == NULL) {
+        goto done;
+    }
+
+    sprintf(tmp_file, "%s.%d.tmp", index_file, getpid());
+
+    if ((fd = open(tmp_file, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) == -1) {
+        debug("unable to create command index '%s': %d\n", tmp_file, errno);
+        goto done;
+    }
+
+    if (write(fd, &header, sizeof(header)) != sizeof(header) ||
+        write(fd, dirs, header.num_dirs * sizeof(command_index_dir)) != header.num_dirs * sizeof(command_index_dir) ||
+        write(fd, buckets, header.num_buckets * sizeof(uint32_t)) != header.num_buckets * sizeof(uint32_t) ||
+        write(fd, entries, header.num_entries * sizeof(command_index_entry)) != header.num_entries * sizeof(command_index_entry) ||
+        write(fd, strings, strings_len) != strings_len) {
+        debug("error: short write of command index\n");
+        close(fd);
+        unlink(tmp_file);
+        goto done;
+    }
+
+    close(fd);
+
+    if (rename(tmp_file, index_file) != 0) {
+        debug("unable to rename command index into place: %d\n", errno);
+        unlink(tmp_file);
+        goto done;
+    }
+
+    debug("built command index of %u commands: '%s'\n", header.num_entries, index_file);
+    ret = 0;
+
+done:
+    free(tmp_file);
+    free(dirs);
+    free(buckets);
+    free(entries);
+    free(strings);
+
+    return ret;
+}
+
+/**
+ * Work out which index file belongs to these dirs, creating ~/.cache/smash if need be.
+ *
+ * @returns 0, or -1 if there's nowhere to keep it
+ */
+int __command_index_locate(string_list *bin_list) {
+    char *home_dir = NULL;
+    uint64_t hash = 14695981039346656037ull;
+    int len = 0;
+
+    struct passwd *pw = NULL;
+
+    if ((home_dir = getenv(ENV_HOME_KEY)) == NULL && ((pw = getpwuid(getuid())) == NULL || (home_dir = pw->pw_dir) == NULL)) {
+        return -1;
+    }
+
+    for (int i = 0; i < bin_list->size; i++) {
+        len += strlen(bin_list->strings[i]) + 1;
+    }
+
+    free(index_path_string);
+    free(index_file);
+
+    if ((index_path_string = malloc(len + 1)) == NULL ||
+        (index_file = malloc(strlen(home_dir) + strlen(COMMAND_INDEX_DIR) + 32)) == NULL) {
+        return -1;
+    }
+
+    index_path_string[0] = '\0';
+
+    for (int i = 0; i < bin_list->size; i++) {
+        if (i > 0) {
+            strcat(index_path_string, BIN_EXEC_DELIM);
+        }
+
+        strcat(index_path_string, bin_list->strings[i]);
+    }
+
+    for (unsigned char *c = (unsigned char *)index_path_string; *c != '\0'; c++) {
+        hash = (hash ^ *c) * 1099511628211ull;
+    }
+
+    /** e.g.) ~/.cache/smash/commands-0123456789abcdef */
+    sprintf(index_file, "%s/.cache", home_dir);
+    mkdir(index_file, 0755);
+    sprintf(index_file, "%s/%s", home_dir, COMMAND_INDEX_DIR);
+    mkdir(index_file, 0755);
+    sprintf(index_file + strlen(index_file), "/commands-%016llx", (unsigned long long)hash);
+
+    return 0;
+}
+
+/**
+ * Open the index for the dirs, building it if it's missing or out of date.
+ *
+ * @returns 0, or -1 if no index can be had
+ */
+int __command_index_open(string_list *bin_list) {
+    __command_index_unmap();
+    index_bin_list = bin_list;
+
+    if (__command_index_locate(bin_list) != 0) {
+        return -1;
+    }
+
+    if (__command_index_map() == 0 && __command_index_fresh()) {
+        return 0;
+    }
+
+    if (__command_index_build() != 0) {
+        return -1;
+    }
+
+    return __command_index_map();
+}
+
+/**
+ * Every bucket & entry probed is checked to lie within the file, & as an index is never more than half full, one without
+ * an empty bucket to end the probing is corrupt too, so a corrupt index can't send the lookup outside of it or round it for ever.
+ *
+ * @returns the index of the dir holding the command, COMMAND_INDEX_NOT_FOUND, or COMMAND_INDEX_UNAVAILABLE if it's corrupt
+ */
+int __command_index_lookup(char *name) {
+    uint32_t *buckets = __command_index_buckets(index_map);
+    command_index_entry *entries = __command_index_entries(index_map);
+    char *strings = __command_index_strings(index_map);
+    uint32_t hash = __command_index_hash(name);
+    uint32_t mask = index_map->num_buckets - 1;
+    uint32_t b = hash & mask;
+    uint32_t probes;
+
+    for (probes = 0; probes < index_map->num_buckets && buckets[b] != 0; probes++, b = (b + 1) & mask) {
+        command_index_entry *entry = NULL;
+
+        if (buckets[b] > index_map->num_entries) {
+            return COMMAND_INDEX_UNAVAILABLE;
+        }
+
+        entry = &entries[buckets[b] - 1];
+
+        if (entry->name_offset >= index_strings_size || entry->dir >= index_bin_list->size) {
+            return COMMAND_INDEX_UNAVAILABLE;
+        }
+
+        if (entry->hash == hash && strcmp(strings + entry->name_offset, name) == 0) {
+            return entry->dir;
+        }
+    }
+
+    return probes < index_map->num_buckets ? COMMAND_INDEX_NOT_FOUND : COMMAND_INDEX_UNAVAILABLE;
+}
+
+/**
+ * Forget the index, as the dirs of the list it was opened for have changed; the next lookup opens theirs.
+ */
+void command_index_close(void) {
+    __command_index_unmap();
+    index_bin_list = NULL;
+}
+
+/**
+ * Find which of the $PATH dirs holds the command.
+ * The dirs are checked for changes on every lookup, found or not: a binary may have been installed (in an earlier dir
+ * than one it now shadows) or removed since the index was built, & a stale index is rebuilt before it's trusted.
+ *
+ * @returns the index of the dir within bin_list, COMMAND_INDEX_NOT_FOUND, or COMMAND_INDEX_UNAVAILABLE
+ */
+int command_index_find(char *name, string_list *bin_list) {
+    int dir;
+
+    if (bin_list != index_bin_list && __command_index_open(bin_list) != 0) {
+        return COMMAND_INDEX_UNAVAILABLE;
+    }
+
+    if (index_map == NULL) {
+        return COMMAND_INDEX_UNAVAILABLE;
+    }
+
+    if ((dir = __command_index_lookup(name)) != COMMAND_INDEX_UNAVAILABLE && __command_index_fresh()) {
+        return dir;
+    }
+
+    /** another process may have rebuilt it already; a corrupt one is rebuilt all the same */
+    if ((dir == COMMAND_INDEX_UNAVAILABLE || __command_index_map() != 0 || !__command_index_fresh()) &&
+        (__command_index_build() != 0 || __command_index_map() != 0)) {
+        debug("error: unable to rebuild the command index\n");
+        return COMMAND_INDEX_UNAVAILABLE;
+    }
+
+    return __command_index_lookup(name);
+}
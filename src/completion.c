@@ -0,0 +1,244 @@
+#include "completion.h"
+
+static string_list *completion_bin_list = NULL;
+
+/**
+ * Builtins & the names in every $PATH dir, sorted & without duplicates.
+ * The names point into the io_dir listings, so the index is checked against their generations before every use.
+ */
+static io_dir_entry *command_index = NULL;
+static int command_count = 0;
+static unsigned long *command_generations = NULL;
+static int command_built = 0;
+
+void completion_set_bin_list(string_list *bin_list) {
+    completion_bin_list = bin_list;
+
+    free(command_generations);
+    command_generations = NULL;
+    command_built = 0;
+}
+
+int __completion_compare(const void *a, const void *b) {
+    return strcmp(((io_dir_entry *)a)->name, ((io_dir_entry *)b)->name);
+}
+
+/**
+ * Make sure the command index is up to date, rebuilding it if any $PATH dir changed since it was built.
+ */
+int __completion_command_index(void) {
+    int dirs = completion_bin_list != NULL ? completion_bin_list->size : 0;
+    io_dir *listings[dirs > 0 ? dirs : 1];
+    int stale = !command_built;
+    int total = 0;
+    int used = 0;
+
+    if (command_generations == NULL && (command_generations = calloc(dirs > 0 ? dirs : 1, sizeof(unsigned long))) == NULL) {
+        return -1;
+    }
+
+    for (int i = 0; i < dirs; i++) {
+        unsigned long generation = 0;
+
+        if ((listings[i] = io_dir_list(completion_bin_list->strings[i])) != NULL) {
+            generation = listings[i]->generation;
+            total += listings[i]->count;
+        }
+
+        if (generation != command_generations[i]) {
+            stale = 1;
+        }
+
+        command_generations[i] = generation;
+    }
+
+    if (!stale) {
+        return 0;
+    }
+
+    for (int i = 0; COMMAND_BUILTINS[i] != NULL; i++) {
+        total++;
+    }
+
+    free(command_index);
+    command_count = 0;
+
+    if ((command_index = malloc((total > 0 ? total : 1) * sizeof(io_dir_entry))) == NULL) {
+        command_built = 0;
+        return -1;
+    }
+
+    for (int i = 0; COMMAND_BUILTINS[i] != NULL; i++) {
+        command_index[used].name = *COMMAND_BUILTINS[i];
+        command_index[used].type = DT_UNKNOWN;
+        used++;
+    }
+
+    for (int i = 0; i < dirs; i++) {
+        if (listings[i] == NULL) {
+            continue;
+        }
+
+        for (int j = 0; j < listings[i]->count; j++) {
+            /** executable bits aren't checked, as that would mean a stat() per name */
+            if (listings[i]->entries[j].type != DT_DIR) {
+                command_index[used++] = listings[i]->entries[j];
+            }
+        }
+    }
+
+    qsort(command_index, used, sizeof(io_dir_entry), __completion_compare);
+
+    /** the same name in several dirs */
+    for (int i = 0; i < used; i++) {
+        if (command_count == 0 || strcmp(command_index[command_count - 1].name, command_index[i].name) != 0) {
+            command_index[command_count++] = command_index[i];
+        }
+    }
+
+    command_built = 1;
+
+    debug("built command index of %d names\n", command_count);
+
+    return 0;
+}
+
+/**
+ * Binary search for the first name at or after prefix in a sorted array of entries.
+ */
+int __completion_lower_bound(io_dir_entry *entries, int count, char *prefix) {
+    int low = 0;
+    int high = count;
+
+    while (low < high) {
+        int mid = (low + high) / 2;
+
+        if (strcmp(entries[mid].name, prefix) < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+/**
+ * Copy the entries that start with prefix into the result. Dot files are left out unless the prefix starts with '.'.
+ */
+int __completion_collect(completion *result, io_dir_entry *entries, int first, int count, char *prefix) {
+    int len = strlen(prefix);
+    int last = first;
+
+    while (last < count && strncmp(entries[last].name, prefix, len) == 0) {
+        last++;
+    }
+
+    if ((result->matches = malloc((last - first > 0 ? last - first : 1) * sizeof(io_dir_entry))) == NULL) {
+        return -1;
+    }
+
+    for (int i = first; i < last; i++) {
+        if (entries[i].name[0] == '.' && prefix[0] != '.') {
+            continue;
+        }
+
+        result->matches[result->count++] = entries[i];
+    }
+
+    return 0;
+}
+
+/**
+ * Find the completions for the word that ends at pos in line (which need not be NUL terminated).
+ *
+ * @returns
+ * 0 with result filled in, which must then be given to completion_free(), or -1 on error.
+ */
+int completion_find(char *line, int len, int pos, completion *result) {
+    char *word = NULL;
+    char *slash = NULL;
+    int first_word = 1;
+    int ret = 0;
+
+    memset(result, 0, sizeof(completion));
+
+    io_dir_trim();
+
+    result->start = pos;
+
+    while (result->start > 0 && !isspace(line[result->start - 1])) {
+        result->start--;
+    }
+
+    for (int i = 0; i < result->start; i++) {
+        if (!isspace(line[i])) {
+            first_word = 0;
+            break;
+        }
+    }
+
+    if ((word = strndup(line + result->start, pos - result->start)) == NULL) {
+        return -1;
+    }
+
+    slash = strrchr(word, '/');
+
+    if (first_word && slash == NULL) {
+        result->command = 1;
+        result->base = result->start;
+
+        if ((ret = __completion_command_index()) == 0) {
+            ret = __completion_collect(result, command_index, __completion_lower_bound(command_index, command_count, word),
+                                       command_count, word);
+        }
+    } else {
+        io_dir *dir = NULL;
+        char *name = word;
+        int first = 0;
+
+        if (slash != NULL) {
+            name = slash + 1;
+
+            /** keep the trailing slash, so that '/' itself still names the root */
+            slash[0] = '\0';
+            dir = io_dir_list(word[0] == '\0' ? ROOT_PATH : word);
+            slash[0] = '/';
+        } else {
+            dir = io_dir_list(".");
+        }
+
+        result->base = result->start + (name - word);
+
+        if (dir != NULL) {
+            io_dir_prefix(dir, name, &first);
+            ret = __completion_collect(result, dir->entries, first, dir->count, name);
+        }
+
+        /** whether a lone match is a dir decides between completing with '/' or ' ' */
+        if (ret == 0 && result->count == 1 && result->matches[0].type != DT_DIR && result->matches[0].type != DT_REG) {
+            char *path = NULL;
+            struct stat st;
+
+            if ((path = malloc(strlen(word) + strlen(result->matches[0].name) + 2)) != NULL) {
+                sprintf(path, "%.*s%s", (int)(name - word), word, result->matches[0].name);
+
+                if (stat(path, &st) == 0 && S_ISDIR(st.st_mode)) {
+                    result->matches[0].type = DT_DIR;
+                }
+
+                free(path);
+            }
+        }
+    }
+
+    free(word);
+
+    return ret;
+}
+
+void completion_free(completion *result) {
+    free(result->matches);
+    result->matches = NULL;
+    result->count = 0;
+}
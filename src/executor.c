@@ -4,10 +4,35 @@
 
 static executor_jobs *execd_job_list;
 
+/** the empty node at the end of the job list, where the oldest jobs are */
+static executor_jobs *execd_tail;
+
+/** jobs in the list, how many of them have finished, & how many finished jobs have been freed */
+static long execd_size;
+static long execd_finished;
+static long execd_freed;
+
+/** the pid that reports --mem-stats on exit; forked children have a copy */
+static pid_t mem_stats_owner = -1;
+
+/** When set, the next external foreground command replaces the shell instead of being forked. */
+static int tail_exec;
+
+/** the $PATH bin_list was last split from */
+static char *bin_list_path = NULL;
+
 executor_jobs *executor_execd_head() {
     return execd_job_list;
 }
 
+/**
+ * Mark the next command as the last one the shell will run (e.g. the final line of a script),
+ * so that an external foreground command can be exec'd in place of the shell, saving a fork and a wait.
+ */
+void executor_set_tail_exec(int enabled) {
+    tail_exec = enabled;
+}
+
 /**
  * Called once to initialize the list of running jobs.
  * Simply creates the **execd_job_list by initializing the first index to 0.
@@ -22,9 +47,43 @@ int executor_init_execd() {
     execd_job_list->next = NULL;
     execd_job_list->prev = NULL;
 
+    execd_tail = execd_job_list;
+
     return 0;
 }
 
+/**
+ * Free the oldest finished jobs, so no more than EXECUTOR_KEEP_FINISHED are kept.
+ * Starts from the tail, where the oldest are; running jobs are never freed.
+ */
+void __executor_collect_jobs() {
+    executor_jobs *current = execd_tail->prev;
+
+    while (execd_finished > EXECUTOR_KEEP_FINISHED && current != NULL) {
+        executor_jobs *prev = current->prev;
+
+        if (current->cmd->running != 1) {
+            /** there's always a next node: the tail */
+            current->next->prev = prev;
+
+            if (prev == NULL) {
+                execd_job_list = current->next;
+            } else {
+                prev->next = current->next;
+            }
+
+            parse_command_free(current->cmd);
+            free(current);
+
+            execd_size--;
+            execd_finished--;
+            execd_freed++;
+        }
+
+        current = prev;
+    }
+}
+
 /**
  * Add a new job to the head of the job list.
  */
@@ -46,6 +105,9 @@ int executor_push_execd(commander *cmd) {
 
     /** set the head to the new one */
     execd_job_list = new;
+    execd_size++;
+
+    __executor_collect_jobs();
 
     return 0;
 }
@@ -109,159 +171,228 @@ void executor_pop_execd(int job_id) {
 }
 
 /**
- * Execute the specified command. This'll add it to the execd_job_list
+ * Build the command's argv as a single block: its full path, then its arguments.
  */
-void executor_exec_bin_command(commander *cmd, string_list *command, char **env_vars) {
-    pid_t pid;
+char **executor_build_argv(commander *cmd) {
+    pointer_pointer_block block = {0};
 
-    // pointer_pointer_debug(env_vars, -1);
-    cmd->started = time(NULL);
+    pointer_pointer_block_size(&block, cmd->bin_dir, "/", cmd->bin);
 
-    if ((pid = fork()) == 0) {
-        /**
-         * Set the process group id to the current process id.
-         */
-        if (setpgid(getpid(), getpid()) != 0) {
-            debug("unable to set the process group id\n");
+    for (int i = 0; i < cmd->num_bin_params; i++) {
+        pointer_pointer_block_size(&block, cmd->bin_params[i], NULL, NULL);
+    }
 
-            return;
-        }
+    if (pointer_pointer_block_alloc(&block) == NULL) {
+        return NULL;
+    }
 
-        /**
-         * Prepare the command & it's arguments
-         */
+    pointer_pointer_block_add(&block, cmd->bin_dir, "/", cmd->bin);
 
-        /** create the entire executable path, binary-dir + binary-name. */
-        char *dest = malloc(strlen(cmd->bin_dir) + strlen(cmd->bin) + 1);
-        memcpy(dest, cmd->bin_dir, strlen(cmd->bin_dir));
+    for (int i = 0; i < cmd->num_bin_params; i++) {
+        pointer_pointer_block_add(&block, cmd->bin_params[i], NULL, NULL);
+    }
 
-        /** add a '/' between the binary-dir and binary-name */
-        dest[strlen(cmd->bin_dir)] = '/';
-        dest[strlen(cmd->bin_dir) + 1] = 0;
+    return block.array;
+}
 
-        /** finally, concatenate */
-        char *full_command = strcat(dest, cmd->bin);
+/**
+ * Replace the current process with the command: applies its redirects, then execve()'s it.
+ * Called in the forked child, or in the shell itself for `exec` and tail-exec. Never returns.
+ */
+void executor_exec_in_process(commander *cmd) {
+    long long trace_start = trace_begin();
 
-        /** command argument prepping - put name of executable path as first argument */
-        char **command_args = malloc(2 * sizeof(char **));
-        command_args[0] = malloc(strlen(full_command) + 1);
-        memcpy(command_args[0], full_command, strlen(full_command));
-        command_args[0][strlen(full_command)] = '\0';
+    /**
+     * Apply the job's resource limits (or the shell-wide defaults)
+     */
+    job_limits_apply(cmd->limits);
 
-        /** more arguments to parse. */
-        if (cmd->num_bin_params > 0) {
-            // command_args = realloc(cmd->bin_params, (cmd->num_bin_params + 1) * sizeof(char *));
-            command_args = pointer_pointer_merge(command_args, 1, cmd->bin_params, cmd->num_bin_params);
-        }
+    /** built by the shell before forking, unless it's replacing itself */
+    if (cmd->argv == NULL && (cmd->argv = executor_build_argv(cmd)) == NULL) {
+        fprintf(stderr, "error: unable to allocate space for arguments\n");
+        exit(ENOMEM);
+    }
 
-        /** +2 b/c 1 for the initial array, and 1 more so that i can get to last index */
-        debug("this: %d, should be 1 larger than the size specified by pp merge\n", (cmd->num_bin_params + 2));
-        command_args = realloc(command_args, (cmd->num_bin_params + 2) * sizeof(char **));
-        command_args[cmd->num_bin_params + 1] = malloc(sizeof(NULL));
-        command_args[cmd->num_bin_params + 1] = NULL;
+    pointer_pointer_debug(cmd->argv, -1);
 
-        pointer_pointer_debug(command_args, cmd->num_bin_params + 2);
+    /**
+     * Change input fd
+     */
+    char *input_path = cmd->input_redirect;
+    int fd_in = -1;
+    if (input_path != NULL) {
+        debug("getting stdin input from a file: '%s'\n", input_path);
 
-        /**
-         * Change input fd
-         */
-        char *input_path = cmd->input_redirect;
-        int fd_in = -1;
-        if (input_path != NULL) {
-            debug("getting stdin input from a file: '%s'\n", input_path);
-
-            if ((fd_in = open(input_path, O_RDONLY)) == -1) {
-                fprintf(stderr, "error: unable to open input file\n");
-                exit(errno);
-            }
+        if ((fd_in = open(input_path, O_RDONLY)) == -1) {
+            fprintf(stderr, "error: unable to open input file\n");
+            exit(errno);
         }
+    }
 
-        /**
-         * The final file to output stdout data to;
-         * if it's not the last command, then should pipe data to next process...
-         */
-        char *output_path = cmd->output_redirect;
-        int fd_out = -1;
-        if (output_path != NULL) {
-            debug("placing stdout output to file: '%s'\n", output_path);
-
-            if ((fd_out = open(output_path, O_WRONLY | O_TRUNC | O_CREAT, 00777)) == -1) {
-                fprintf(stderr, "error: unable to open stdout output file\n");
-                exit(errno);
-            }
-        }
+    /**
+     * The final file to output stdout data to;
+     * if it's not the last command, then should pipe data to next process...
+     */
+    char *output_path = cmd->output_redirect;
+    int fd_out = -1;
+    if (output_path != NULL) {
+        debug("placing stdout output to file: '%s'\n", output_path);
 
-        /**
-         * The final file to output stderr data to;
-         * if it's not the last command, then should pipe data to next process...
-         */
-        char *output_err_path = cmd->output_error_redirect;
-        int fd_err_out = -1;
-        if (output_err_path != NULL) {
-            debug("placing stderr output to file: '%s'\n", output_err_path);
-
-            if ((fd_err_out = open(output_err_path, O_WRONLY | O_TRUNC | O_CREAT, 00777)) == -1) {
-                fprintf(stderr, "error: unable to open stderr output file\n");
-                exit(errno);
-            }
+        if ((fd_out = open(output_path, O_WRONLY | O_TRUNC | O_CREAT, 00777)) == -1) {
+            fprintf(stderr, "error: unable to open stdout output file\n");
+            exit(errno);
         }
+    }
 
-        /**
-         * Now replace stdin with fd_in if necessary
-         */
-        if (fd_in != -1) {
-            if (dup2(fd_in, fileno(stdin)) == -1) {
-                fprintf(stderr, "error: unable to replace infile with fd.\n");
-                exit(errno);
-            }
+    /**
+     * The final file to output stderr data to;
+     * if it's not the last command, then should pipe data to next process...
+     */
+    char *output_err_path = cmd->output_error_redirect;
+    int fd_err_out = -1;
+    if (output_err_path != NULL) {
+        debug("placing stderr output to file: '%s'\n", output_err_path);
 
-            close(fd_in);
+        if ((fd_err_out = open(output_err_path, O_WRONLY | O_TRUNC | O_CREAT, 00777)) == -1) {
+            fprintf(stderr, "error: unable to open stderr output file\n");
+            exit(errno);
         }
+    }
 
-        /**
-         * Replace stdout with fd_out if necessary
-         */
-        if (fd_out != -1) {
-            if (dup2(fd_out, fileno(stdout)) == -1) {
-                fprintf(stderr, "error: unable to replace outfile with fd.\n");
-                exit(errno);
-            }
+    /**
+     * Now replace stdin with fd_in if necessary
+     */
+    if (fd_in != -1) {
+        if (dup2(fd_in, fileno(stdin)) == -1) {
+            fprintf(stderr, "error: unable to replace infile with fd.\n");
+            exit(errno);
+        }
+
+        close(fd_in);
+    }
 
-            close(fd_out);
+    /**
+     * Replace stdout with fd_out if necessary
+     */
+    if (fd_out != -1) {
+        if (dup2(fd_out, fileno(stdout)) == -1) {
+            fprintf(stderr, "error: unable to replace outfile with fd.\n");
+            exit(errno);
         }
 
-        /**
-         * Replace stdout with fd_out if necessary
-         */
-        if (fd_err_out != -1) {
-            if (dup2(fd_err_out, fileno(stderr)) == -1) {
-                fprintf(stderr, "error: unable to replace outerr with fd.\n");
-                exit(errno);
-            }
+        close(fd_out);
+    }
 
-            close(fd_err_out);
+    /**
+     * Replace stdout with fd_out if necessary
+     */
+    if (fd_err_out != -1) {
+        if (dup2(fd_err_out, fileno(stderr)) == -1) {
+            fprintf(stderr, "error: unable to replace outerr with fd.\n");
+            exit(errno);
         }
 
+        close(fd_err_out);
+    }
+
+    /**
+     * Execute the command & it's arguments
+     */
+    errno = 0;
+    debug("RUNNING: %s\n", cmd->argv[0]);
+    fflush(stderr);
+
+    pointer_pointer_debug(parse_path_envp(), -1);
+
+    /** on the job's own track when forked, the shell's for exec & tail-exec */
+    trace_span(getpid(), TRACE_EXEC, cmd->bin, trace_start);
+    trace_flush();
+
+    if (execve(cmd->argv[0], cmd->argv, parse_path_envp()) == -1) {
+        fprintf(stderr, "error: execv failed to execute, errno: '%d'\n", errno);
+        exit(errno);
+    }
+}
+
+/**
+ * Execute the specified command. This'll add it to the execd_job_list
+ */
+void executor_exec_bin_command(commander *cmd, string_list *command) {
+    pid_t pid;
+
+    long long fork_start;
+    char *track_name = NULL;
+
+    /** build the environment here rather than in the child, so it's only ever rebuilt after a change */
+    parse_path_envp();
+
+    /** and the arguments, so the child has nothing left to allocate */
+    cmd->argv = executor_build_argv(cmd);
+
+    if (cmd->timeout_ns == 0) {
+        cmd->timeout_ns = reaper_default_timeout();
+    }
+
+    /** SMASH_JOB_OUTPUT=prefix gives background jobs pipes, so their lines can't interleave */
+    if (cmd->bgfg == 1 && job_output_enabled()) {
+        job_output_open(cmd);
+    }
+
+    cmd->started = time(NULL);
+    cmd->trace_start = trace_begin();
+    fork_start = metrics_now();
+
+    if ((pid = fork()) == 0) {
         /**
-         * Execute the command & it's arguments
+         * Set the process group id to the current process id.
          */
-        errno = 0;
-        debug("RUNNING: %s\n", full_command);
-        fflush(stderr);
-
-        pointer_pointer_debug(env_vars, -1);
+        if (setpgid(getpid(), getpid()) != 0) {
+            debug("unable to set the process group id\n");
 
-        if (execve(dest, command_args, env_vars) == -1) {
-            fprintf(stderr, "error: execv failed to execute, errno: '%d'\n", errno);
-            exit(errno);
+            return;
         }
+
+        job_output_redirect(cmd);
+        executor_exec_in_process(cmd);
     } else if (pid == -1) {
         fprintf(stderr, "error: unable to fork");
         exit(errno);
     }
 
+    job_output_close_writers(cmd);
+
+    /** the child has its own copy, of its expanded params too, which can be huge after globbing */
+    free(cmd->argv);
+    cmd->argv = NULL;
+    string_list_free(cmd->params);
+    cmd->params = NULL;
+    cmd->bin_params = NULL;
+    cmd->num_bin_params = 0;
+
+    /** nor does the shell need the tokens it was parsed from, which its caller frees */
+    cmd->raw_command->size = 0;
+    cmd->output_redirect = NULL;
+    cmd->output_error_redirect = NULL;
+    cmd->input_redirect = NULL;
+
+    cmd->timing.spawn_ns = metrics_now() - fork_start;
+    trace_end(TRACE_FORK, cmd->bin, cmd->trace_start);
+
+    /** each job gets a track of its own, e.g.) 'job 3: sleep 1 &' */
+    if (trace_enabled() && (track_name = string_list_string(command)) != NULL) {
+        char label[64 + strlen(track_name)];
+
+        sprintf(label, "job %d: %s", cmd->job_id, track_name);
+        trace_track(pid, label);
+        free(track_name);
+    }
+
     debug("exec new commands - parent pid: %d (spawned child: %d)\n", getpid(), pid);
     cmd->pid = pid;
+    cmd->running = 1;
+
+    reaper_watch(cmd);
+    reaper_set_timeout(cmd);
 
     /**
      * Push the command we just began running into the running jobs list.
@@ -274,14 +405,60 @@ void executor_exec_bin_command(commander *cmd, string_list *command, char **env_
     return;
 }
 
+/**
+ * Keep the bin dirs in step with $PATH: split it into bin_list again whenever it has changed since, whether by an
+ * assignment, `export`, `unset` or a command's 'PATH=...' prefix. The first call only notes the $PATH it was split from.
+ * The list is changed in place, so everything holding it sees the new dirs; the command index & completion are re-keyed.
+ */
+void executor_sync_bin_list(string_list *bin_list) {
+    char *path = NULL;
+
+    if ((path = parse_path_get_env(ENV_PATH_KEY)) == NULL && (path = strdup("")) == NULL) {
+        return;
+    }
+
+    if (bin_list_path != NULL && strcmp(path, bin_list_path) == 0) {
+        free(path);
+        return;
+    }
+
+    if (bin_list_path != NULL) {
+        debug("$PATH changed to '%s'\n", path);
+
+        /** split from a copy, as strtok() writes into it */
+        free(bin_list_path);
+        bin_list_path = strdup(path);
+        parse_path_bin_dirs_into(bin_list, path);
+        free(path);
+
+        command_index_close();
+        completion_set_bin_list(bin_list);
+
+        return;
+    }
+
+    bin_list_path = path;
+}
+
+/**
+ * Find which of the bin dirs has the command; a lookup in the shared command index,
+ * or a search through each dir in turn when there's no index to be had.
+ */
 char *executor_find_binary(char *command, string_list *bin_list) {
     struct dirent *de;
+    int dir;
 
     if (bin_list == NULL) {
         fprintf(stderr, "error: no binary list available from parsed PATH dir.\n");
         return NULL;
     }
 
+    executor_sync_bin_list(bin_list);
+
+    if ((dir = command_index_find(command, bin_list)) != COMMAND_INDEX_UNAVAILABLE) {
+        return dir == COMMAND_INDEX_NOT_FOUND ? NULL : bin_list->strings[dir];
+    }
+
     for (int i = 0; i < bin_list->size; i++) {
         DIR *dr;
 
@@ -307,22 +484,124 @@ char *executor_find_binary(char *command, string_list *bin_list) {
     return NULL;
 }
 
-int executor_exec_command(string_list *command, string_list *bin_list, char **env_vars) {
+/**
+ * $ exec cmd args - execve() the command in place of the shell; only returns if it can't be run.
+ */
+int __exec_replace_shell(string_list *command, string_list *bin_list) {
+    string_list *replacement = NULL;
     commander *cmd = NULL;
-    char *home_dir = NULL;
 
-    if (command == NULL) {
-        return COMMAND_RETURN_RETRY;
+    if (command->size == 1) {
+        set_last_return_value(0);
+        return COMMAND_RETURN_INTERNAL_CMD;
     }
 
-    /**
-     * Further parse the command, into something a little more complex than just a string list.
-     */
-    if ((cmd = parse_command_from_string_list(command)) == NULL) {
+    if ((replacement = string_list_from(command->strings[1])) == NULL) {
+        return COMMAND_RETURN_EXEC_ERR;
+    }
+
+    for (int i = 2; i < command->size; i++) {
+        string_list_push(replacement, command->strings[i]);
+    }
+
+    if ((cmd = parse_command_from_string_list(replacement)) == NULL) {
         fprintf(stderr, "error: parse command returned null\n");
         return COMMAND_RETURN_EXEC_ERR;
     }
 
+    if ((cmd->bin_dir = executor_find_binary(cmd->bin, bin_list)) == NULL) {
+        fprintf(stderr, "smash: exec: command not found: %s\n", cmd->bin);
+        set_last_return_value(COMMAND_RETURN_NOT_FOUND);
+        parse_command_free(cmd);
+        string_list_free(replacement);
+
+        return COMMAND_RETURN_RETRY;
+    }
+
+    fflush(NULL);
+    metrics_flush();
+    executor_exec_in_process(cmd);
+
+    return COMMAND_RETURN_EXEC_ERR;
+}
+
+/**
+ * Call a shell function in this process, with its arguments as the positional parameters $1..$N.
+ * Only the external commands within its body are forked.
+ */
+int __exec_function(function_entry *function, commander *cmd, string_list *bin_list) {
+    string_list *params = NULL;
+    string_list *caller_params = NULL;
+    function_body *body = NULL;
+    int caller_tail_exec;
+    int ret;
+
+    if ((params = string_list_new()) == NULL) {
+        return COMMAND_RETURN_EXEC_ERR;
+    }
+
+    for (int i = 0; i < cmd->num_bin_params; i++) {
+        string_list_push(params, cmd->bin_params[i]);
+    }
+
+    debug("calling function: '%s'\n", function->name);
+
+    set_last_return_value(0);
+
+    /** the function body has more commands to run, so its last command must not replace the shell */
+    caller_tail_exec = tail_exec;
+    tail_exec = 0;
+
+    /** held until the call returns, as the body may redefine the function (& so free its own body) as it runs */
+    body = function_table_retain(function);
+
+    caller_params = parse_path_set_positional(params);
+    ret = executor_exec_script(body->nodes, bin_list);
+    parse_path_set_positional(caller_params);
+
+    function_table_release(body);
+
+    tail_exec = caller_tail_exec;
+
+    string_list_free(params);
+
+    if (ret == COMMAND_RETURN_EXIT) {
+        return ret;
+    }
+
+    return COMMAND_RETURN_INTERNAL_CMD;
+}
+
+/**
+ * $ KEY=value... - with no command after them, assignments set shell variables.
+ */
+int __exec_assignments(string_list *command) {
+    for (int i = 0; i < command->size; i++) {
+        char *delim = strchr(command->strings[i], ENV_DELIM[0]);
+
+        /** never write into the token itself; parsed scripts re-use their tokens */
+        char key[delim - command->strings[i] + 1];
+
+        memcpy(key, command->strings[i], delim - command->strings[i]);
+        key[delim - command->strings[i]] = NULL_CHAR;
+
+        if (parse_path_set_env(key, delim + 1) != 0) {
+            set_last_return_value(COMMAND_RETURN_RETRY);
+            return COMMAND_RETURN_RETRY;
+        }
+    }
+
+    set_last_return_value(0);
+
+    return COMMAND_RETURN_INTERNAL_CMD;
+}
+
+/**
+ * Run a parsed command; a builtin or function in the shell, or anything else as a new job.
+ */
+int __exec_commander(commander *cmd, string_list *command, string_list *bin_list, metrics_timing *timing) {
+    char *home_dir = NULL;
+
     if ((home_dir = getenv("HOME")) == NULL) {
         home_dir = getpwuid(getuid())->pw_dir;
     }
@@ -333,9 +612,9 @@ int executor_exec_command(string_list *command, string_list *bin_list, char **en
      * Then if still not found - try to find the command in one of the /bin/ dirs.
      */
 
-    /** $ history - show previous commands executed */
-    if (internal_command_history_write(home_dir, HISTORY_FILE, command) != 0) {
-        fprintf(stderr, "warning: unable to write command to history file.\n");
+    /** $ exec cmd args - replace the shell with the command */
+    if (strcmp(command->strings[0], COMMAND_EXEC) == 0) {
+        return __exec_replace_shell(command, bin_list);
     }
 
     /** $ exit - exit the prog. */
@@ -352,6 +631,8 @@ int executor_exec_command(string_list *command, string_list *bin_list, char **en
             return COMMAND_RETURN_RETRY;
         }
 
+        set_last_return_value(0);
+
         return COMMAND_RETURN_INTERNAL_CMD;
     }
 
@@ -376,6 +657,11 @@ int executor_exec_command(string_list *command, string_list *bin_list, char **en
             return COMMAND_RETURN_RETRY;
         }
 
+        /** keep the tracked cwd current, so prompts don't need to ask for it */
+        internal_command_pwd_update();
+
+        set_last_return_value(0);
+
         return COMMAND_RETURN_INTERNAL_CMD;
     }
 
@@ -388,17 +674,73 @@ int executor_exec_command(string_list *command, string_list *bin_list, char **en
             return COMMAND_RETURN_RETRY;
         }
 
+        set_last_return_value(0);
+
         return COMMAND_RETURN_INTERNAL_CMD;
     }
 
+    /** $ export [KEY[=value]]... - pass variables on to later commands */
+    if (strcmp(command->strings[0], COMMAND_EXPORT) == 0) {
+        set_last_return_value(internal_command_export(command));
+
+        return get_last_return_value() == 0 ? COMMAND_RETURN_INTERNAL_CMD : COMMAND_RETURN_RETRY;
+    }
+
+    /** $ unset KEY... - remove variables */
+    if (strcmp(command->strings[0], COMMAND_UNSET) == 0) {
+        set_last_return_value(internal_command_unset(command));
+
+        return get_last_return_value() == 0 ? COMMAND_RETURN_INTERNAL_CMD : COMMAND_RETURN_RETRY;
+    }
+
+    /** $ ulimit - show or set the default resource limits of later jobs */
+    if (strcmp(command->strings[0], COMMAND_ULIMIT) == 0) {
+        if (internal_command_ulimit(command) != 0) {
+            set_last_return_value(COMMAND_RETURN_RETRY);
+
+            return COMMAND_RETURN_RETRY;
+        }
+
+        set_last_return_value(0);
+
+        return COMMAND_RETURN_INTERNAL_CMD;
+    }
+
+    /** $ parallel [-j N] cmd {} ::: items - fan the command out over the items, at most N jobs at a time */
+    if (strcmp(command->strings[0], COMMAND_PARALLEL) == 0) {
+        set_last_return_value(internal_command_parallel(command, bin_list, cmd->limits));
+
+        return get_last_return_value() == 0 ? COMMAND_RETURN_INTERNAL_CMD : COMMAND_RETURN_RETRY;
+    }
+
+    /** $ name args - shell functions cost a single hash probe, and are found before searching the bin dirs. */
+    function_entry *function = NULL;
+
+    if ((function = function_table_get(command->strings[0])) != NULL) {
+        timing->kind = METRICS_KIND_FUNCTION;
+        return __exec_function(function, cmd, bin_list);
+    }
+
     /** Since not matching any builtin commands - search in bin dirs. */
     char *bin_dir = NULL;
 
-    if ((bin_dir = executor_find_binary(command->strings[0], bin_list)) == NULL) {
+    timing->kind = METRICS_KIND_EXTERNAL;
+    long long trace_start = trace_begin();
+
+    timing->lookup_ns = metrics_now();
+    bin_dir = executor_find_binary(command->strings[0], bin_list);
+    timing->lookup_ns = metrics_now() - timing->lookup_ns;
+
+    trace_end(TRACE_LOOKUP, command->strings[0], trace_start);
+
+    if (bin_dir == NULL) {
         if (command->strings[0][0] == '#') {
+            timing->kind = NULL;
             return COMMAND_RETURN_COMMENT;
         }
 
+        /** reported here, where the name is known without any prefixes, e.g.) 'cmd' of 'timeout 5 cmd' */
+        fprintf(stderr, "smash: command not found: %s\n", command->strings[0]);
         set_last_return_value(COMMAND_RETURN_NOT_FOUND);
 
         return COMMAND_RETURN_NOT_FOUND;
@@ -408,43 +750,641 @@ int executor_exec_command(string_list *command, string_list *bin_list, char **en
 
     debug("found binary path at: '%s'\n", bin_dir);
 
+    /**
+     * Nothing left to run after this command, so rather than forking & waiting, become the command.
+     * Background jobs would lose their parent's reaping, so only when none are still running,
+     * and a time limit needs the shell around to enforce it. Nor with --metrics, as the command's record is only
+     * written once the shell reaps it, or with --mem-stats, which are reported as the shell exits.
+     */
+    if (tail_exec == 1 && cmd->bgfg != 1 && cmd->timeout_ns == 0 && reaper_default_timeout() == 0 && executor_has_running_jobs() == 0 &&
+        !metrics_enabled() && getpid() != mem_stats_owner) {
+        debug("tail-exec of the final command: '%s'\n", cmd->bin);
+        fflush(NULL);
+        metrics_flush();
+        executor_exec_in_process(cmd);
+    }
+
     /**
      * Execute the binary w/ it's arguments and other misc. info.
      * Call this after finding and setting the binary.
      */
-    pointer_pointer_debug(env_vars, -1);
-    executor_exec_bin_command(cmd, command, env_vars);
+
+    /** the job's record is written once it's reaped */
+    cmd->timing = *timing;
+    timing->command = NULL;
+
+    executor_exec_bin_command(cmd, command);
     executor_debug_execd();
 
+    /** a background job's status is only that it started, so the next step doesn't see whatever ran before it */
+    if (cmd->bgfg == 1) {
+        set_last_return_value(0);
+    }
+
     return COMMAND_RETURN_SUCCESS;
 }
 
-executor_jobs *executor_newest_job() {
-    executor_jobs *current = execd_job_list;
-    executor_jobs *newest = execd_job_list;
+int __exec_command(string_list *command, string_list *bin_list, string_list *assignments, metrics_timing *timing) {
+    commander *cmd = NULL;
+    job_limits *limits = NULL;
+    string_list unprefixed;
+    long long timeout_ns = 0;
+    long long kill_after_ns = 0;
+    int num_prefixes;
+    int ret;
 
+    if (command == NULL) {
+        return COMMAND_RETURN_RETRY;
+    }
+
+    /**
+     * Strip resource control prefixes, e.g.) '@cpus=0-3 @nice=10 cmd'.
+     * With no command after them, they become the defaults for every later job.
+     */
+    if ((num_prefixes = job_limits_parse_prefixes(command, &limits)) == -1) {
+        set_last_return_value(COMMAND_RETURN_RETRY);
+        return COMMAND_RETURN_RETRY;
+    }
+
+    if (num_prefixes == command->size) {
+        job_limits_set_defaults(limits);
+        free(limits);
+        set_last_return_value(0);
+
+        return COMMAND_RETURN_INTERNAL_CMD;
+    }
+
+    /** $ timeout [-k GRACE] DURATION cmd args - a time limit on the job, rather than a command of its own */
+    if (num_prefixes < command->size && strcmp(command->strings[num_prefixes], COMMAND_TIMEOUT) == 0) {
+        int first = num_prefixes + 1;
+
+        if (first + 1 < command->size && strcmp(command->strings[first], "-k") == 0) {
+            kill_after_ns = reaper_parse_duration(command->strings[first + 1]);
+            first += 2;
+        }
+
+        if (first + 1 >= command->size || kill_after_ns == -1 || (timeout_ns = reaper_parse_duration(command->strings[first])) == -1) {
+            fprintf(stderr, "usage: timeout [-k GRACE] DURATION cmd [args...]\n");
+            free(limits);
+            set_last_return_value(COMMAND_RETURN_RETRY);
+
+            return COMMAND_RETURN_RETRY;
+        }
+
+        num_prefixes = first + 1;
+    }
+
+    if (num_prefixes > 0) {
+        /** a view of the same tokens, past the prefixes */
+        unprefixed.size = command->size - num_prefixes;
+        unprefixed.strings = command->strings + num_prefixes;
+        command = &unprefixed;
+    }
+
+    /**
+     * Further parse the command, into something a little more complex than just a string list.
+     */
+    timing->parse_ns = metrics_now();
+
+    if ((cmd = parse_command_from_string_list(command)) == NULL) {
+        fprintf(stderr, "error: parse command returned null\n");
+        return COMMAND_RETURN_EXEC_ERR;
+    }
+
+    timing->parse_ns = metrics_now() - timing->parse_ns;
+    timing->kind = METRICS_KIND_BUILTIN;
+
+    /** the command's own 'KEY=value' prefixes; set after its arguments were expanded */
+    if (assignments != NULL) {
+        parse_path_set_env_overrides(assignments);
+    }
+
+    cmd->limits = limits;
+    cmd->timeout_ns = timeout_ns;
+    cmd->kill_after_ns = kill_after_ns;
+
+    ret = __exec_commander(cmd, command, bin_list, timing);
+
+    /** only jobs are kept, in the job list; a builtin's or function's commander is done with */
+    if (cmd->started == -1) {
+        parse_command_free(cmd);
+    }
+
+    return ret;
+}
+
+/**
+ * Run a command line; builtins & functions in the shell, anything else as a new job.
+ * With --metrics on, builtins & functions are logged here, & jobs once they're reaped.
+ */
+int executor_exec_command(string_list *command, string_list *bin_list) {
+    metrics_timing timing;
+    long long trace_start = trace_begin();
+    string_list *overrides = parse_path_get_env_overrides();
+    string_list assignments;
+    string_list assigned;
+    int num_assignments = 0;
+    int ret;
+
+    metrics_start(&timing, metrics_enabled() && command != NULL ? string_list_string(command) : NULL);
+
+    while (command != NULL && num_assignments < command->size && parse_path_is_assignment(command->strings[num_assignments])) {
+        num_assignments++;
+    }
+
+    if (num_assignments > 0 && num_assignments == command->size) {
+        timing.kind = METRICS_KIND_BUILTIN;
+        ret = __exec_assignments(command);
+    } else if (num_assignments > 0) {
+        /** 'KEY=value cmd': views of the same tokens; the values are only in the command's environment */
+        assignments.size = num_assignments;
+        assignments.strings = command->strings;
+        assigned.size = command->size - num_assignments;
+        assigned.strings = command->strings + num_assignments;
+
+        ret = __exec_command(&assigned, bin_list, &assignments, &timing);
+        parse_path_set_env_overrides(overrides);
+    } else {
+        ret = __exec_command(command, bin_list, NULL, &timing);
+    }
+
+    trace_end(TRACE_COMMAND, command != NULL && command->size > 0 ? command->strings[0] : NULL, trace_start);
+
+    if (timing.kind != NULL && ret != COMMAND_RETURN_EXEC_ERR) {
+        metrics_record(&timing, get_last_return_value(), NULL);
+    }
+
+    free(timing.command);
+
+    return ret;
+}
+
+/**
+ * Jobs are pushed onto the head of the list, so the head is always the newest job.
+ * (Comparing 'started' timestamps can't tell apart jobs started within the same second.)
+ */
+executor_jobs *executor_newest_job() {
     debug("getting newest existing job\n");
 
-    if (current == NULL || current->cmd == NULL) {
+    if (execd_job_list == NULL || execd_job_list->cmd == NULL) {
         debug("no existing newest job\n");
         return NULL;
     }
 
-    while (current->cmd != NULL) {
-        debug("getting newest existing job2\n");
-        if (current->cmd->started >= newest->cmd->started) {
-            newest = current;
+    return execd_job_list;
+}
+
+/**
+ * Reap any jobs that have already exited, then check whether any are still running.
+ * @returns 1 if some job is still running, 0 otherwise
+ */
+int executor_has_running_jobs() {
+    int running = 0;
+
+    reaper_poll();
+
+    for (executor_jobs *current = execd_job_list; current != NULL && current->cmd != NULL; current = current->next) {
+        struct rusage usage;
+        int status;
+
+        if (current->cmd->running != 1) {
+            continue;
         }
 
-        /** Go to next job */
-        if (current->next == NULL) {
-            break;
+        /** jobs without a pidfd aren't seen by the reaper */
+        if (current->cmd->pidfd == -1 && wait4(current->cmd->pid, &status, WNOHANG, &usage) > 0) {
+            executor_job_done(current->cmd, status, &usage);
+        } else {
+            running = 1;
         }
+    }
 
-        current = current->next;
+    return running;
+}
+
+/**
+ * Count the jobs still running, as of the last time they were reaped. Makes no system calls.
+ */
+int executor_count_running_jobs() {
+    int running = 0;
+
+    for (executor_jobs *current = execd_job_list; current != NULL && current->cmd != NULL; current = current->next) {
+        if (current->cmd->running == 1) {
+            running++;
+        }
+    }
+
+    return running;
+}
+
+/**
+ * Record that a job has exited with the given wait4() status & resource usage.
+ */
+void executor_job_done(commander *cmd, int status, struct rusage *usage) {
+    /** what the job wrote before exiting comes out before anything about its exit */
+    job_output_drain();
+
+    if (WIFEXITED(status)) {
+        cmd->exit_code = WEXITSTATUS(status);
+    } else if (WIFSIGNALED(status)) {
+        cmd->exit_code = 128 + WTERMSIG(status);
+    }
+
+    if (cmd->timed_out == 1) {
+        fprintf(stderr, "smash: timed out: %s (job %d)\n", cmd->bin, cmd->job_id);
+        cmd->exit_code = REAPER_TIMEOUT_EXIT;
+    }
+
+    debug("ENDED: '%s'(ret=%d)\n", cmd->bin, cmd->exit_code);
+
+    cmd->running = -1;
+    cmd->finished = time(NULL);
+    execd_finished++;
+
+    reaper_unwatch(cmd);
+    metrics_record(&cmd->timing, cmd->exit_code, usage);
+
+    /** the job's lifetime, from fork until it was reaped */
+    if (trace_enabled()) {
+        char exit_code[24];
+
+        sprintf(exit_code, "exit %d", cmd->exit_code);
+        trace_span(cmd->pid, cmd->bin, exit_code, cmd->trace_start);
+    }
+
+    /** $? is the status of the last foreground job; background jobs finish whenever they happen to */
+    if (cmd->bgfg != 1) {
+        set_last_return_value(cmd->exit_code);
+    }
+}
+
+/**
+ * Block until a foreground job has exited, leaving its exit status as the last return value.
+ * Background jobs that finish in the meantime are reaped too; otherwise they're left to the reaper.
+ *
+ * @returns the exit code of the job
+ */
+int executor_wait_job(commander *cmd) {
+    if (cmd == NULL || cmd->bgfg == 1 || cmd->running != 1) {
+        return get_last_return_value();
+    }
+
+    if (reaper_wait_job(cmd) == -1) {
+        return get_last_return_value();
+    }
+
+    return cmd->exit_code;
+}
+
+/**
+ * Run a single parsed command, waiting for it when it's a foreground job.
+ */
+int __exec_script_command(string_list *command, string_list *bin_list) {
+    executor_jobs *newest = NULL;
+    int ret;
+
+    if (strcmp(command->strings[0], COMMAND_BREAK) == 0) {
+        return COMMAND_RETURN_BREAK;
+    }
+
+    if (strcmp(command->strings[0], COMMAND_CONTINUE) == 0) {
+        return COMMAND_RETURN_CONTINUE;
+    }
+
+    /** $ return [n] - leave the function being run, with the optional exit status */
+    if (strcmp(command->strings[0], COMMAND_RETURN) == 0) {
+        if (command->size > 1) {
+            set_last_return_value(atoi(command->strings[1]));
+        }
+
+        return COMMAND_RETURN_FUNCTION_RETURN;
+    }
+
+    if ((ret = executor_exec_command(command, bin_list)) == COMMAND_RETURN_SUCCESS && (newest = executor_newest_job()) != NULL) {
+        executor_wait_job(newest->cmd);
+    }
+
+    return ret;
+}
+
+/**
+ * Run the body of a loop once; tells the loop whether to keep going.
+ *
+ * @returns 1 to keep looping, 0 to stop, or COMMAND_RETURN_EXIT/COMMAND_RETURN_FUNCTION_RETURN to unwind further
+ */
+int __exec_script_loop_body(script_node *body, string_list *bin_list) {
+    int ret = executor_exec_script(body, bin_list);
+
+    if (ret == COMMAND_RETURN_EXIT || ret == COMMAND_RETURN_FUNCTION_RETURN) {
+        return ret;
+    }
+
+    return ret == COMMAND_RETURN_BREAK ? 0 : 1;
+}
+
+/**
+ * Point the shell's own stdin, stdout & stderr at the redirects of a group, e.g.) '{ ...; } > out', keeping the fds
+ * they replace in saved (-1 for any left alone). Every file is opened before any fd is replaced.
+ *
+ * @returns 0, or -1 if a file couldn't be opened, in which case nothing is redirected
+ */
+int __exec_redirect(string_list *redirects, int saved[3]) {
+    char *paths[3] = {NULL, NULL, NULL};
+    int flags[3] = {O_RDONLY, O_WRONLY | O_TRUNC | O_CREAT, O_WRONLY | O_TRUNC | O_CREAT};
+    int fds[3] = {-1, -1, -1};
+
+    saved[STDIN_FILENO] = saved[STDOUT_FILENO] = saved[STDERR_FILENO] = -1;
+
+    if (redirects == NULL) {
+        return 0;
+    }
+
+    parse_command_redirects(redirects, &paths[STDIN_FILENO], &paths[STDOUT_FILENO], &paths[STDERR_FILENO]);
+
+    for (int i = 0; i < 3; i++) {
+        if (paths[i] != NULL && (fds[i] = open(paths[i], flags[i] | O_CLOEXEC, 00777)) == -1) {
+            fprintf(stderr, "smash: unable to open '%s' for redirect\n", paths[i]);
+
+            while (--i >= 0) {
+                if (fds[i] != -1) {
+                    close(fds[i]);
+                }
+            }
+
+            return -1;
+        }
+    }
+
+    /** whatever the shell wrote before still goes where it was meant to */
+    fflush(NULL);
+
+    for (int i = 0; i < 3; i++) {
+        if (fds[i] != -1) {
+            saved[i] = fcntl(i, F_DUPFD_CLOEXEC, EXECUTOR_SAVED_FD_MIN);
+            dup2(fds[i], i);
+            close(fds[i]);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Put back the fds replaced by __exec_redirect().
+ */
+void __exec_restore_redirect(int saved[3]) {
+    fflush(NULL);
+
+    for (int i = 0; i < 3; i++) {
+        if (saved[i] != -1) {
+            dup2(saved[i], i);
+            close(saved[i]);
+        }
+    }
+}
+
+/**
+ * Run a '{ ...; }' group in the shell itself, with its redirects opened once around all of it.
+ */
+int __exec_script_group(script_node *node, string_list *bin_list) {
+    int saved[3];
+    int ret;
+
+    if (__exec_redirect(node->command, saved) != 0) {
+        set_last_return_value(1);
+        return COMMAND_RETURN_EXEC_ERR;
     }
 
-    return newest;
+    ret = executor_exec_script(node->body, bin_list);
+    __exec_restore_redirect(saved);
+
+    return ret;
+}
+
+/**
+ * Run a '( ... )' subshell: forked once, so nothing it changes (its directory, variables or functions) reaches the shell.
+ * Its last command replaces the subshell when it can, so e.g.) '( cd dir; make )' forks just once in all.
+ */
+int __exec_script_subshell(script_node *node, string_list *bin_list) {
+    script_node *step = NULL;
+    script_node *next = NULL;
+    int saved[3];
+    int status;
+    pid_t pid;
+
+    /** or the subshell would write out the shell's buffered output a second time */
+    fflush(NULL);
+
+    if ((pid = fork()) == -1) {
+        fprintf(stderr, "error: unable to fork\n");
+        set_last_return_value(1);
+        return COMMAND_RETURN_EXEC_ERR;
+    }
+
+    if (pid == 0) {
+        /** none of the shell's jobs are the subshell's to wait on, nor are its epoll sets to share */
+        executor_init_execd();
+        execd_size = execd_finished = execd_freed = 0;
+        reaper_reinit();
+        metrics_reinit();
+
+        if (__exec_redirect(node->command, saved) != 0) {
+            exit(1);
+        }
+
+        /** steps are run one at a time, off the subshell's own copy of the tree, to know which is the last */
+        for (step = node->body; step != NULL; step = next) {
+            int ret;
+
+            next = step->next;
+            step->next = NULL;
+
+            executor_set_tail_exec(next == NULL && step->type == SCRIPT_NODE_COMMAND);
+
+            if ((ret = executor_exec_script(step, bin_list)) == COMMAND_RETURN_EXIT || ret == COMMAND_RETURN_FUNCTION_RETURN ||
+                ret == COMMAND_RETURN_BREAK || ret == COMMAND_RETURN_CONTINUE) {
+                break;
+            }
+        }
+
+        exit(get_last_return_value());
+    }
+
+    while (waitpid(pid, &status, 0) == -1 && errno == EINTR) {
+    }
+
+    set_last_return_value(WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status));
+
+    return COMMAND_RETURN_SUCCESS;
+}
+
+/**
+ * Expand the items of a for loop. A '$VAR' item is replaced by the words of its value.
+ */
+string_list *__exec_script_for_items(string_list *items) {
+    string_list *expanded = NULL;
+    char *value = NULL;
+
+    if ((expanded = string_list_new()) == NULL) {
+        return NULL;
+    }
+
+    for (int i = 0; items != NULL && i < items->size; i++) {
+        string_list *words = NULL;
+
+        if (items->strings[i][0] != VARIABLE_START_KEY || (value = parse_path_get_env(items->strings[i] + 1)) == NULL) {
+            string_list_push(expanded, items->strings[i]);
+            continue;
+        }
+
+        if ((words = string_list_from_delim(value, " ")) != NULL) {
+            for (int j = 0; j < words->size; j++) {
+                string_list_push(expanded, words->strings[j]);
+            }
+
+            string_list_free(words);
+        }
+
+        free(value);
+    }
+
+    return expanded;
+}
+
+/**
+ * Walk a parsed script list, running each node in order.
+ * Loop bodies are executed straight from the tree, so they're never re-read or re-tokenized.
+ *
+ * @returns the COMMAND_RETURN_* code of the last node run; its exit status is the last return value.
+ */
+int executor_exec_script(script_node *node, string_list *bin_list) {
+    int ret = COMMAND_RETURN_SUCCESS;
+
+    for (; node != NULL; node = node->next) {
+        /** the step before it has been waited on, so $? is its real status; a skipped step isn't even looked up */
+        if ((node->run_if == SCRIPT_RUN_IF_SUCCESS && get_last_return_value() != 0) ||
+            (node->run_if == SCRIPT_RUN_IF_FAILURE && get_last_return_value() == 0)) {
+            continue;
+        }
+
+        if (node->type == SCRIPT_NODE_COMMAND) {
+            ret = __exec_script_command(node->command, bin_list);
+        } else if (node->type == SCRIPT_NODE_LIST) {
+            ret = executor_exec_script(node->body, bin_list);
+        } else if (node->type == SCRIPT_NODE_GROUP) {
+            ret = __exec_script_group(node, bin_list);
+        } else if (node->type == SCRIPT_NODE_SUBSHELL) {
+            ret = __exec_script_subshell(node, bin_list);
+        } else if (node->type == SCRIPT_NODE_IF) {
+            if ((ret = executor_exec_script(node->condition, bin_list)) == COMMAND_RETURN_EXIT || ret == COMMAND_RETURN_FUNCTION_RETURN) {
+                return ret;
+            }
+
+            if (get_last_return_value() == 0) {
+                ret = executor_exec_script(node->body, bin_list);
+            } else {
+                ret = executor_exec_script(node->else_body, bin_list);
+            }
+        } else if (node->type == SCRIPT_NODE_WHILE) {
+            /** the loop's status is its body's last, or 0 if the body never ran, not that of the condition that ended it */
+            int status = 0;
+
+            ret = 1;
+
+            while (ret == 1) {
+                if ((ret = executor_exec_script(node->condition, bin_list)) == COMMAND_RETURN_EXIT || ret == COMMAND_RETURN_FUNCTION_RETURN) {
+                    return ret;
+                }
+
+                if (get_last_return_value() != 0) {
+                    break;
+                }
+
+                ret = __exec_script_loop_body(node->body, bin_list);
+                status = ret == 0 ? 0 : get_last_return_value();
+            }
+
+            if (ret == COMMAND_RETURN_EXIT || ret == COMMAND_RETURN_FUNCTION_RETURN) {
+                return ret;
+            }
+
+            set_last_return_value(status);
+            ret = COMMAND_RETURN_SUCCESS;
+        } else if (node->type == SCRIPT_NODE_FOR) {
+            string_list *items = NULL;
+
+            if ((items = __exec_script_for_items(node->command)) == NULL) {
+                return COMMAND_RETURN_EXEC_ERR;
+            }
+
+            int status = 0;
+
+            ret = 1;
+
+            for (int i = 0; ret == 1 && i < items->size; i++) {
+                parse_path_set_env(node->variable, items->strings[i]);
+                ret = __exec_script_loop_body(node->body, bin_list);
+                status = ret == 0 ? 0 : get_last_return_value();
+            }
+
+            string_list_free(items);
+
+            if (ret == COMMAND_RETURN_EXIT || ret == COMMAND_RETURN_FUNCTION_RETURN) {
+                return ret;
+            }
+
+            set_last_return_value(status);
+
+            ret = COMMAND_RETURN_SUCCESS;
+        } else if (node->type == SCRIPT_NODE_FUNCTION) {
+            /** the definition may run again (e.g. inside a loop), so the table keeps its own copy of the body */
+            if (function_table_set(node->variable, parse_script_copy(node->body)) != 0) {
+                fprintf(stderr, "error: unable to define function '%s'\n", node->variable);
+                return COMMAND_RETURN_EXEC_ERR;
+            }
+
+            set_last_return_value(0);
+            ret = COMMAND_RETURN_INTERNAL_CMD;
+        }
+
+        if (ret == COMMAND_RETURN_EXIT || ret == COMMAND_RETURN_BREAK || ret == COMMAND_RETURN_CONTINUE || ret == COMMAND_RETURN_FUNCTION_RETURN) {
+            return ret;
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * Report the jobs held in the job list & the memory they take up to stderr; registered with atexit() by --mem-stats.
+ */
+void __executor_report_mem_stats(void) {
+    struct mallinfo2 heap = mallinfo2();
+    struct rusage usage;
+    size_t held = sizeof(executor_jobs);
+
+    if (getpid() != mem_stats_owner) {
+        return;
+    }
+
+    for (executor_jobs *current = execd_job_list; current != NULL && current->cmd != NULL; current = current->next) {
+        held += sizeof(executor_jobs) + parse_command_size(current->cmd);
+    }
+
+    getrusage(RUSAGE_SELF, &usage);
+
+    fprintf(stderr, "smash: mem-stats: %ld jobs held (%ld running, %ld finished), %ld finished jobs freed\n", execd_size,
+            execd_size - execd_finished, execd_finished, execd_freed);
+    fprintf(stderr, "smash: mem-stats: %zu bytes held by the job list, %zu bytes of heap in use, max rss %ld kB\n", held,
+            heap.uordblks + heap.hblkhd, usage.ru_maxrss);
+}
+
+/**
+ * Turn on the --mem-stats report, written when the shell exits.
+ */
+void executor_enable_mem_stats() {
+    mem_stats_owner = getpid();
+    atexit(__executor_report_mem_stats);
 }
 
 /**
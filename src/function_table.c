@@ -0,0 +1,101 @@
+#include "function_table.h"
+
+static function_entry *function_table[FUNCTION_TABLE_BUCKETS];
+
+/**
+ * FNV-1a hash of the function name.
+ */
+unsigned int __function_table_hash(char *name) {
+    unsigned int hash = 2166136261u;
+
+    while (*name != '\0') {
+        hash ^= (unsigned char)*name++;
+        hash *= 16777619u;
+    }
+
+    return hash % FUNCTION_TABLE_BUCKETS;
+}
+
+/**
+ * Take a reference to the function's current body, e.g.) for the length of a call.
+ */
+function_body *function_table_retain(function_entry *entry) {
+    entry->body->refs++;
+
+    return entry->body;
+}
+
+/**
+ * Drop a reference to a body, freeing it once nothing (neither the table nor a running call) refers to it.
+ */
+void function_table_release(function_body *body) {
+    if (body == NULL || --body->refs > 0) {
+        return;
+    }
+
+    parse_script_free(body->nodes);
+    free(body);
+}
+
+/**
+ * Define (or redefine) a function. The table takes ownership of the body.
+ */
+int function_table_set(char *name, script_node *body) {
+    function_entry *entry = NULL;
+    function_body *counted = NULL;
+    unsigned int bucket = __function_table_hash(name);
+
+    if ((counted = malloc(sizeof(function_body))) == NULL) {
+        debug("error: unable to allocate space for function body\n");
+        parse_script_free(body);
+        return -1;
+    }
+
+    counted->nodes = body;
+    counted->refs = 1;
+
+    for (entry = function_table[bucket]; entry != NULL; entry = entry->next) {
+        if (strcmp(entry->name, name) == 0) {
+            debug("redefining function: '%s'\n", name);
+
+            /** a call to the old body that's still running keeps it until it returns */
+            function_table_release(entry->body);
+            entry->body = counted;
+
+            return 0;
+        }
+    }
+
+    if ((entry = malloc(sizeof(function_entry))) == NULL) {
+        debug("error: unable to allocate space for function entry\n");
+        function_table_release(counted);
+        return -1;
+    }
+
+    if ((entry->name = strdup(name)) == NULL) {
+        debug("error: unable to allocate space for function name\n");
+        function_table_release(counted);
+        free(entry);
+        return -1;
+    }
+
+    entry->body = counted;
+    entry->next = function_table[bucket];
+    function_table[bucket] = entry;
+
+    return 0;
+}
+
+/**
+ * Look up a function by name.
+ * @returns the function's entry (its body may be an empty list), or NULL if no such function is defined
+ */
+function_entry *function_table_get(char *name) {
+    for (function_entry *entry = function_table[__function_table_hash(name)]; entry != NULL; entry = entry->next) {
+        if (strcmp(entry->name, name) == 0) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
@@ -0,0 +1,192 @@
+#include "glob_expand.h"
+
+/**
+ * Whether the word is a pattern, rather than an argument to pass through as it is.
+ */
+int glob_expand_has_magic(char *word) {
+    return strpbrk(word, GLOB_EXPAND_MAGIC) != NULL;
+}
+
+/**
+ * Whether the entry at path is a directory; only asks the filesystem when its listing doesn't say.
+ */
+int __glob_expand_is_dir(io_dir_entry *entry, char *path) {
+    struct stat st;
+
+    if (entry->type == DT_DIR) {
+        return 1;
+    }
+
+    if (entry->type != DT_UNKNOWN && entry->type != DT_LNK) {
+        return 0;
+    }
+
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+/**
+ * The listing of the directory path[0..len), which is empty for the current directory & otherwise ends in a '/'.
+ */
+io_dir *__glob_expand_list(char *path, size_t len) {
+    io_dir *dir = NULL;
+
+    if (len == 0) {
+        return io_dir_list(".");
+    }
+
+    if (len == 1) {
+        return io_dir_list(ROOT_PATH);
+    }
+
+    /** listed without its trailing '/', so it shares the cache entry of the same directory named without one */
+    path[len - 1] = NULL_CHAR;
+    dir = io_dir_list(path);
+    path[len - 1] = '/';
+
+    return dir;
+}
+
+/**
+ * Expand the rest of the pattern within the directory path[0..len), one component at a time.
+ * path is a PATH_MAX buffer, which is written past len as the matches are built up.
+ *
+ * @returns the number of matches pushed
+ */
+int __glob_expand_in(char *path, size_t len, char *rest, string_list *matches) {
+    char component[NAME_MAX + 1];
+    char prefix[NAME_MAX + 1];
+    size_t component_len = strcspn(rest, "/");
+    int has_slash = rest[component_len] == '/';
+    char *next = rest + component_len;
+    io_dir *dir = NULL;
+    struct stat st;
+    int count = 0;
+    int first;
+    int num;
+
+    if (component_len > NAME_MAX || len + component_len + 2 > PATH_MAX) {
+        return 0;
+    }
+
+    while (*next == '/') {
+        next++;
+    }
+
+    memcpy(component, rest, component_len);
+    component[component_len] = NULL_CHAR;
+
+    /** a literal component only has to exist */
+    if (!glob_expand_has_magic(component)) {
+        memcpy(path + len, component, component_len + 1);
+        len += component_len;
+
+        if (!has_slash) {
+            if (lstat(path, &st) == -1) {
+                return 0;
+            }
+
+            string_list_push_len(matches, path, len);
+            return 1;
+        }
+
+        path[len++] = '/';
+        path[len] = NULL_CHAR;
+
+        if (*next != NULL_CHAR) {
+            return __glob_expand_in(path, len, next, matches);
+        }
+
+        if (stat(path, &st) == -1 || !S_ISDIR(st.st_mode)) {
+            return 0;
+        }
+
+        string_list_push_len(matches, path, len);
+        return 1;
+    }
+
+    if ((dir = __glob_expand_list(path, len)) == NULL) {
+        return 0;
+    }
+
+    /** only the names starting with the component's literal start can match it */
+    memcpy(prefix, component, strcspn(component, GLOB_EXPAND_MAGIC "\\"));
+    prefix[strcspn(component, GLOB_EXPAND_MAGIC "\\")] = NULL_CHAR;
+    num = io_dir_prefix(dir, prefix, &first);
+
+    for (int i = first; i < first + num; i++) {
+        char *name = dir->entries[i].name;
+        size_t name_len;
+
+        /** hidden names only match a component that starts with a '.' itself */
+        if (name[0] == '.' && component[0] != '.') {
+            continue;
+        }
+
+        if (fnmatch(component, name, FNM_PERIOD) != 0) {
+            continue;
+        }
+
+        if (len + (name_len = strlen(name)) + 2 > PATH_MAX) {
+            continue;
+        }
+
+        memcpy(path + len, name, name_len + 1);
+
+        if (!has_slash) {
+            string_list_push_len(matches, path, len + name_len);
+            count++;
+            continue;
+        }
+
+        if (!__glob_expand_is_dir(&dir->entries[i], path)) {
+            continue;
+        }
+
+        path[len + name_len] = '/';
+        path[len + name_len + 1] = NULL_CHAR;
+
+        if (*next == NULL_CHAR) {
+            string_list_push_len(matches, path, len + name_len + 1);
+            count++;
+        } else {
+            count += __glob_expand_in(path, len + name_len + 1, next, matches);
+        }
+    }
+
+    return count;
+}
+
+/**
+ * Push every path matching the pattern onto matches, in sorted order.
+ *
+ * @returns
+ * the number of matches pushed; with none, the caller should pass the pattern through as it is.
+ */
+int glob_expand(char *pattern, string_list *matches) {
+    char path[PATH_MAX];
+    char *rest = pattern;
+    size_t len = 0;
+    int count;
+
+    if (rest[0] == '/') {
+        path[len++] = '/';
+
+        while (*rest == '/') {
+            rest++;
+        }
+    }
+
+    path[len] = NULL_CHAR;
+
+    if (*rest == NULL_CHAR) {
+        return 0;
+    }
+
+    io_dir_trim();
+
+    count = __glob_expand_in(path, len, rest, matches);
+
+    debug("expanded '%s' into %d paths\n", pattern, count);
+
+    return count;
+}
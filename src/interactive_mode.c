@@ -1,69 +1,115 @@
 #include "interactive_mode.h"
 
-int interactive_mode_run(int argc, char *argv[], string_list *bin_list, char **env_vars) {
+/** whether merging in the history failed last time, so a failure that persists is only reported once */
+static int history_sync_failed = 0;
+
+/**
+ * Housekeeping before each prompt: buffered metrics & trace events are written out while the user types,
+ * rather than in the middle of commands, other sessions' history is merged in, & a finished compaction of the
+ * history file is reaped. A changed $PATH is picked up too, so completion offers the commands of its dirs.
+ */
+void __interactive_mode_idle(string_list *bin_list) {
+    int failed;
+
+    metrics_flush();
+    trace_flush();
+    executor_sync_bin_list(bin_list);
+    internal_command_history_reap();
+
+    /** the shell carries on with the history it has */
+    if ((failed = internal_command_history_sync() != 0) && !history_sync_failed) {
+        fprintf(stderr, "warning: unable to merge in the history of other sessions.\n");
+    }
+
+    history_sync_failed = failed;
+}
+
+/**
+ * Hands the reader the line typed at the prompt, once.
+ */
+char *__interactive_mode_next_line(void *data) {
+    char **line = data;
+    char *next = *line;
+
+    *line = NULL;
+
+    return next;
+}
+
+/**
+ * Run a line typed at the prompt, as a script of its own, so that it may hold a list like 'make && ./test || echo failed',
+ * or a whole compound command on one line. Each foreground job is waited on before the next step runs.
+ *
+ * @returns COMMAND_RETURN_EXIT if the shell should exit
+ */
+int __interactive_mode_run_line(char *input_line, string_list *bin_list) {
+    script_reader *reader = NULL;
+    script_node *node = NULL;
+    int ret = COMMAND_RETURN_SUCCESS;
+
+    if ((reader = parse_script_reader_new(-1, NULL)) == NULL) {
+        fprintf(stderr, "error: unable to create script reader\n");
+        free(input_line);
+        return COMMAND_RETURN_RETRY;
+    }
+
+    reader->source = __interactive_mode_next_line;
+    reader->source_data = &input_line;
+
+    while (ret != COMMAND_RETURN_EXIT && (node = parse_script_next(reader)) != NULL) {
+        ret = executor_exec_script(node, bin_list);
+        parse_script_free(node);
+    }
+
+    /** as a script with a syntax error exits */
+    if (reader->error == 1) {
+        set_last_return_value(1);
+    }
+
+    parse_script_reader_free(reader);
+
+    return ret;
+}
+
+int interactive_mode_run(int argc, char *argv[], string_list *bin_list) {
     char *input_line = NULL;
+    char *home_dir = NULL;
+
+    if ((home_dir = getenv(ENV_HOME_KEY)) == NULL) {
+        home_dir = getpwuid(getuid())->pw_dir;
+    }
+
+    completion_set_bin_list(bin_list);
+
+    /** up/down recall in the line editor comes from the history ring */
+    if (internal_command_history_load(home_dir, HISTORY_FILE) != 0) {
+        fprintf(stderr, "warning: unable to load history.\n");
+    }
 
     /**
      * Read in a line of text
      */
-    while ((input_line = readline(PROMPT, fileno(stdin))) != NULL) {
-        string_list *cmd = NULL;
-        int executor_ret;
+    while (1) {
+        __interactive_mode_idle(bin_list);
+
+        if ((input_line = line_editor_readline(prompt_template(), fileno(stdin))) == NULL) {
+            break;
+        }
 
         debug("input read: '%s'\n", input_line);
 
-        if ((cmd = parse_command_to_string_list(strdup(input_line))) == NULL) {
-            fprintf(stdout, "\n");
-            continue;
+        /** only lines typed at the prompt are history, not the commands of scripts & functions they run */
+        if (internal_command_history_write(home_dir, HISTORY_FILE, input_line) != 0) {
+            fprintf(stderr, "warning: unable to write command to history file.\n");
         }
 
-        /** Debug */
-        string_list_debug(cmd);
-
-        /** Check output of executor */
-        if ((executor_ret = executor_exec_command(cmd, bin_list, env_vars)) == COMMAND_RETURN_EXIT) {
+        /** the reader records the line in the session, & frees it */
+        if (__interactive_mode_run_line(input_line, bin_list) == COMMAND_RETURN_EXIT) {
             fprintf(stdout, "\n");
             return 0;
-        } else if (executor_ret == COMMAND_RETURN_RETRY) {
-            /** error should be given by executor */
-            fprintf(stdout, "\n");
-            continue;
-        } else if (executor_ret == COMMAND_RETURN_NOT_FOUND) {
-            fprintf(stderr, "smash: command not found: %s\n", cmd->strings[0]);
-            fprintf(stdout, "\n");
-            continue;
-        } else if (executor_ret == COMMAND_RETURN_COMMENT) {
-            fprintf(stdout, "\n");
-            continue;
-        } else if (executor_ret == COMMAND_RETURN_INTERNAL_CMD) {
-            debug("finished executing internal command\n");
-            fprintf(stdout, "\n");
-            continue;
-        } else {
-            debug("finally just continue\n");
-
-            /**
-             * Wait for previous job to finish.
-             * Must get most recently created job first... Then check if it's done.
-             */
-            executor_jobs *newest;
-            if ((newest = executor_newest_job()) == NULL) {
-                debug("there is no existing newest job\n");
-            } else {
-                debug("the newest job was started on: %d\n", newest->cmd->started);
-                debug("waiting for job to complete before prompting\n");
-
-                /** When a job finishes, break out of waiting and allow prompt */
-                while (has_completed != 1)
-                    ;
-
-                debug("technically job done so can prompt\n");
-            }
-
-            fprintf(stdout, "\n");
-
-            continue;
         }
+
+        fprintf(stdout, "\n");
     }
 
     return 1;
@@ -0,0 +1,60 @@
+#include "internal_command/export.h"
+
+/**
+ * $ export [KEY[=value]]...
+ * Marks each variable to be passed on to the commands run from now on, setting it first when given a value.
+ * With no arguments, prints every exported variable.
+ */
+int internal_command_export(string_list *command) {
+    int ret = 0;
+
+    if (command->size == 1) {
+        parse_path_print_exported();
+        return 0;
+    }
+
+    for (int i = 1; i < command->size; i++) {
+        char *arg = command->strings[i];
+        int len = parse_path_name_length(arg);
+
+        if (len == 0 || (arg[len] != NULL_CHAR && arg[len] != ENV_DELIM[0])) {
+            fprintf(stderr, "smash: export: not a valid name: '%s'\n", arg);
+            ret = 1;
+            continue;
+        }
+
+        if (arg[len] == NULL_CHAR) {
+            parse_path_export_env(arg, NULL);
+            continue;
+        }
+
+        arg[len] = NULL_CHAR;
+        parse_path_export_env(arg, arg + len + 1);
+        arg[len] = ENV_DELIM[0];
+    }
+
+    return ret;
+}
+
+/**
+ * $ unset KEY...
+ * Removes each variable, so it's no longer set, nor passed on to commands.
+ */
+int internal_command_unset(string_list *command) {
+    int ret = 0;
+
+    for (int i = 1; i < command->size; i++) {
+        char *arg = command->strings[i];
+        int len = parse_path_name_length(arg);
+
+        if (len == 0 || arg[len] != NULL_CHAR) {
+            fprintf(stderr, "smash: unset: not a valid name: '%s'\n", arg);
+            ret = 1;
+            continue;
+        }
+
+        parse_path_unset_env(arg);
+    }
+
+    return ret;
+}
@@ -1,69 +1,665 @@
 #include "internal_command/history.h"
 
-int internal_command_history(char *home_path, char *history_file) {
-    char *input_line = NULL;
-    int command_count = 1;
-    FILE *in_file = NULL;
-    char path[MAX_PATH];
+/**
+ * The most recent $HISTSIZE history entries, kept in memory so that neither the `history` builtin
+ * nor the line editor's up/down recall has to go back to the file.
+ * Entries are whole history file lines, timestamp included; history_start is the oldest.
+ */
+static char **history_ring = NULL;
+static int history_capacity = 0;
+static int history_start = 0;
+static int history_count = 0;
+static int history_loaded = 0;
+
+/** at most how many lines the file keeps ($HISTFILESIZE), & how many it has as far as this session knows */
+static long history_file_size = 0;
+static long history_file_lines = 0;
+
+/** the process compacting the history file, or -1 */
+static pid_t history_compact_pid = -1;
+
+/** this session's descriptor of the history file, & which file it is; a compaction replaces the file */
+static char *history_path = NULL;
+static int history_fd = -1;
+static dev_t history_dev = 0;
+static ino_t history_ino = 0;
+
+/**
+ * With $HISTSHARE set, commands other sessions append are merged into the ring. history_offset is how far
+ * into the file this session has read, & history_last_line the line that ends there, to find the place
+ * again once a compaction has rewritten the file.
+ */
+static int history_share = 0;
+static off_t history_offset = 0;
+static char *history_last_line = NULL;
+
+/**
+ * Join the home dir and history file name; sized to fit, so deep home dirs work.
+ */
+char *__history_path(char *home_path, char *history_file) {
+    char *path = NULL;
+
+    if ((path = malloc(strlen(home_path) + strlen(history_file) + 2)) == NULL) {
+        debug("error: unable to allocate space for history path\n");
+        return NULL;
+    }
 
     sprintf(path, "%s/%s", home_path, history_file);
 
-    if ((in_file = fopen(path, "rab+")) == NULL) {
-        fprintf(stderr, "error: unable to open history file for reading: %s\n", path);
-        return 1;
+    return path;
+}
+
+/**
+ * A numeric shell variable, or fallback if it's unset or not a number.
+ */
+long __history_env_long(char *key, long fallback) {
+    char *value = NULL;
+    char *end = NULL;
+    long number;
+
+    if ((value = parse_path_get_env(key)) == NULL) {
+        return fallback;
     }
 
-    debug("wanting to print internal command history.\n");
-    while ((input_line = readline(NULL, fileno(in_file))) != NULL) {
-        fprintf(stdout, "%-5d", command_count);
-        fprintf(stdout, "%s\n", input_line);
+    number = strtol(value, &end, 10);
+
+    if (end == value || *end != NULL_CHAR || number < 0) {
+        number = fallback;
+    }
+
+    free(value);
+
+    return number;
+}
+
+/**
+ * Whether $HISTCONTROL, a ':' separated list, has the option (or 'ignoreboth', which implies both ignore options).
+ */
+int __history_control(char *option) {
+    char *value = NULL;
+    char *token = NULL;
+    char *save = NULL;
+    int found = 0;
+
+    if ((value = parse_path_get_env(ENV_HISTCONTROL_KEY)) == NULL) {
+        return 0;
+    }
+
+    for (token = strtok_r(value, ":", &save); token != NULL; token = strtok_r(NULL, ":", &save)) {
+        if (strcmp(token, option) == 0 || (strcmp(token, HISTORY_IGNORE_BOTH) == 0 && strncmp(option, "ignore", 6) == 0)) {
+            found = 1;
+            break;
+        }
+    }
+
+    free(value);
+
+    return found;
+}
+
+/**
+ * Add a line as the newest entry, dropping the oldest once the ring is full. Takes ownership of line.
+ */
+void __history_push(char *line) {
+    int slot;
+
+    if (history_capacity == 0) {
+        free(line);
+        return;
+    }
+
+    slot = (history_start + history_count) % history_capacity;
+
+    if (history_count == history_capacity) {
+        free(history_ring[history_start]);
+        history_start = (history_start + 1) % history_capacity;
+    } else {
+        history_count++;
+    }
+
+    history_ring[slot] = line;
+}
+
+/**
+ * Read chunks backwards from the end of the file until wanted lines are buffered,
+ * so the cost is the same no matter how long the history file has grown.
+ *
+ * @returns
+ * the buffered tail of the file, which the caller must free, or NULL on error.
+ * *start is set to the offset of the first whole line within it, & *lines to the number of lines from there.
+ * *more is set if the file has lines before those.
+ */
+char *__history_read_tail(int fd, long wanted, long *length, long *start, long *lines, int *more) {
+    char *buf = NULL;
+    long offset = 0;
+    long used = 0;
+    long newlines = 0;
+
+    if ((offset = lseek(fd, 0, SEEK_END)) == -1) {
+        return NULL;
+    }
+
+    /** one extra newline is needed to know the oldest kept line is whole */
+    while (offset > 0 && newlines <= wanted) {
+        long chunk = offset < HISTORY_READ_CHUNK ? offset : HISTORY_READ_CHUNK;
+        char *new_buf = NULL;
+
+        if ((new_buf = realloc(buf, used + chunk + 1)) == NULL) {
+            free(buf);
+            return NULL;
+        }
+
+        buf = new_buf;
+        offset -= chunk;
+
+        memmove(buf + chunk, buf, used);
+
+        if (pread(fd, buf, chunk, offset) != chunk) {
+            free(buf);
+            return NULL;
+        }
+
+        used += chunk;
+
+        for (long i = 0; i < chunk; i++) {
+            if (buf[i] == '\n') {
+                newlines++;
+            }
+        }
+    }
+
+    if (buf == NULL) {
+        /** empty file */
+        if ((buf = malloc(1)) == NULL) {
+            return NULL;
+        }
+    }
+
+    buf[used] = '\0';
+    *length = used;
+    *start = 0;
+    *lines = 0;
+    *more = offset > 0;
+
+    if (offset > 0) {
+        /** the first line was cut off by the chunk boundary */
+        char *newline = strchr(buf, '\n');
+        *start = newline == NULL ? used : newline - buf + 1;
+    }
+
+    /** drop whole lines from the front until only the wanted ones are left */
+    for (long i = *start; i < used; i++) {
+        if (buf[i] == '\n') {
+            (*lines)++;
+        }
+    }
+
+    if (used > 0 && buf[used - 1] != '\n') {
+        (*lines)++;
+    }
+
+    while (*lines > wanted) {
+        char *newline = memchr(buf + *start, '\n', used - *start);
+
+        *start = newline == NULL ? used : newline - buf + 1;
+        *more = 1;
+        (*lines)--;
+    }
+
+    return buf;
+}
+
+/**
+ * Open & lock the history file. Appends take a shared lock & compaction an exclusive one.
+ * If a compaction renamed a new file into place while waiting for the lock, the new file is opened & locked instead.
+ *
+ * @returns
+ * the locked descriptor, which is fd itself if it was still current, or -1 on error.
+ */
+int __history_open_locked(char *path, int fd, int operation) {
+    struct stat path_st;
+    struct stat fd_st;
+
+    while (1) {
+        if (fd == -1 && (fd = open(path, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600)) == -1) {
+            return -1;
+        }
+
+        if (flock(fd, operation) == -1) {
+            close(fd);
+            return -1;
+        }
+
+        if (stat(path, &path_st) == 0 && fstat(fd, &fd_st) == 0 && path_st.st_dev == fd_st.st_dev && path_st.st_ino == fd_st.st_ino) {
+            return fd;
+        }
+
+        /** closing drops the lock too */
+        close(fd);
+        fd = -1;
+    }
+}
+
+/**
+ * Remember the line that now ends at history_offset.
+ */
+void __history_set_last_line(char *line, long size) {
+    free(history_last_line);
+    history_last_line = strndup(line, size);
+}
+
+/**
+ * Read the whole lines between history_offset & end, which other sessions appended, into the ring.
+ */
+void __history_read_new(off_t end) {
+    char *buf = NULL;
+    char *line = NULL;
+    char *newline = NULL;
+    long length = end - history_offset;
+
+    if (length <= 0 || (buf = malloc(length)) == NULL) {
+        return;
+    }
 
-        command_count++;
+    if (pread(history_fd, buf, length, history_offset) != length) {
+        free(buf);
+        return;
     }
 
-    fclose(in_file);
+    /** a line still being written by another session is left for next time */
+    for (line = buf; (newline = memchr(line, '\n', buf + length - line)) != NULL; line = newline + 1) {
+        if (newline > line) {
+            __history_push(strndup(line, newline - line));
+            __history_set_last_line(line, newline - line);
+        }
+
+        history_file_lines++;
+    }
+
+    debug("merged %ld bytes of history from other sessions\n", (long)(line - buf));
+
+    history_offset += line - buf;
+    free(buf);
+}
+
+/**
+ * The history file was replaced by a compaction; find where this session had read up to in the new one.
+ */
+void __history_realign(void) {
+    long length = 0;
+    long start = 0;
+    long lines = 0;
+    int more = 0;
+    char *file = NULL;
+    long last_len = history_last_line != NULL ? strlen(history_last_line) : 0;
+
+    if ((file = __history_read_tail(history_fd, LONG_MAX, &length, &start, &lines, &more)) == NULL) {
+        return;
+    }
+
+    /** when the line didn't survive the compaction, every line kept is newer than it */
+    history_offset = 0;
+    history_file_lines = lines;
+
+    /** the last copy of the line, searching back from the end */
+    for (long end = length - 1; last_len > 0 && end >= last_len; end--) {
+        if (file[end] == '\n' && (end - last_len == 0 || file[end - last_len - 1] == '\n') &&
+            memcmp(file + end - last_len, history_last_line, last_len) == 0) {
+            history_offset = end + 1;
+            break;
+        }
+    }
+
+    debug("history file was compacted, reading on from %ld\n", (long)history_offset);
+
+    free(file);
+}
+
+/**
+ * Take a shared lock on this session's history file, following it to the new file after a compaction.
+ */
+int __history_lock(void) {
+    struct stat st;
+
+    if ((history_fd = __history_open_locked(history_path, history_fd, LOCK_SH)) == -1 || fstat(history_fd, &st) == -1) {
+        return -1;
+    }
+
+    if (st.st_dev != history_dev || st.st_ino != history_ino) {
+        history_dev = st.st_dev;
+        history_ino = st.st_ino;
+
+        if (history_share) {
+            __history_realign();
+        }
+    }
 
     return 0;
 }
 
-int internal_command_history_write(char *home_path, char *history_file, string_list *command) {
-    FILE *in_file = NULL;
-    char *raw_cmd = NULL;
-    time_t current_time;
-    char path[MAX_PATH];
-    char timestamp[22];
+/**
+ * Rewrite the history file with only its last keep lines. The new file is written beside it & renamed
+ * over it, so the history file is never seen half written.
+ */
+int __history_compact(char *path, long keep) {
+    long length = 0;
+    long start = 0;
+    long lines = 0;
+    int more = 0;
+    char *tail = NULL;
+    char *tmp_path = NULL;
+    int fd = -1;
+    int tmp_fd = -1;
+    int ret = -1;
 
-    if ((raw_cmd = string_list_string(command)) == NULL) {
-        fprintf(stderr, "warning: unable to get full raw command from string list.\n");
+    /** held until the new file has been renamed into place, so that no append in between is lost */
+    if ((fd = __history_open_locked(path, -1, LOCK_EX)) == -1) {
+        return -1;
     }
 
-    sprintf(path, "%s/%s", home_path, history_file);
+    tail = __history_read_tail(fd, keep, &length, &start, &lines, &more);
+
+    if (tail == NULL || (tmp_path = malloc(strlen(path) + 32)) == NULL) {
+        free(tail);
+        close(fd);
+        return -1;
+    }
+
+    sprintf(tmp_path, "%s.compact.%d", path, getpid());
+
+    if ((tmp_fd = open(tmp_path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600)) != -1) {
+        if (write(tmp_fd, tail + start, length - start) == length - start && fsync(tmp_fd) == 0 && rename(tmp_path, path) == 0) {
+            ret = 0;
+        }
+
+        close(tmp_fd);
+    }
+
+    if (ret != 0) {
+        unlink(tmp_path);
+    }
+
+    close(fd);
+    free(tmp_path);
+    free(tail);
 
-    if ((in_file = fopen(path, "a+")) == NULL) {
-        fprintf(stderr, "error: unable to open history file for reading: %s\n", path);
+    return ret;
+}
+
+/**
+ * Reap the compaction's process if it has finished, so it's not left a zombie.
+ *
+ * @returns 0 if there's none running (any longer), 1 if it's still running
+ */
+int internal_command_history_reap(void) {
+    if (history_compact_pid == -1) {
+        return 0;
+    }
+
+    if (waitpid(history_compact_pid, NULL, WNOHANG) == 0) {
         return 1;
     }
 
-    time(&current_time);
-    struct tm ts = *localtime(&current_time);
-    strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S $ ", &ts);
+    history_compact_pid = -1;
+
+    return 0;
+}
+
+/**
+ * Compact the history file down to $HISTFILESIZE lines in a child process, so the prompt isn't held up by it.
+ */
+void __history_compact_background(void) {
+    /** one at a time */
+    if (internal_command_history_reap() != 0) {
+        return;
+    }
+
+    if ((history_compact_pid = fork()) == 0) {
+        _exit(__history_compact(history_path, history_file_size) == 0 ? 0 : 1);
+    }
+
+    if (history_compact_pid == -1) {
+        debug("unable to fork to compact the history file: %d\n", errno);
+    } else {
+        debug("compacting history file in process %d\n", history_compact_pid);
+        history_file_lines = history_file_size;
+    }
+}
+
+/**
+ * Preload the ring from the tail of the history file. Only does anything the first time it's called.
+ */
+int internal_command_history_load(char *home_path, char *history_file) {
+    long length = 0;
+    long start = 0;
+    long lines = 0;
+    int more = 0;
+    char *tail = NULL;
+
+    if (history_loaded) {
+        return 0;
+    }
+
+    history_capacity = __history_env_long(ENV_HISTSIZE_KEY, HISTORY_SIZE_DEFAULT);
+    history_file_size = __history_env_long(ENV_HISTFILESIZE_KEY, history_capacity);
+    history_share = __history_env_long(ENV_HISTSHARE_KEY, 0) != 0;
+
+    if (history_capacity > 0 && (history_ring = malloc(history_capacity * sizeof(char *))) == NULL) {
+        fprintf(stderr, "error: unable to allocate space for history.\n");
+        return 1;
+    }
+
+    if ((history_path = __history_path(home_path, history_file)) == NULL) {
+        return 1;
+    }
 
-    if (write(fileno(in_file), timestamp, 22) != 22) {
-        fprintf(stderr, "error: short write when timestamp to history file.\n");
+    if (__history_lock() != 0) {
+        fprintf(stderr, "error: unable to open history file for reading: %s\n", history_path);
         return 1;
     }
 
-    if (write(fileno(in_file), raw_cmd, strlen(raw_cmd)) != strlen(raw_cmd)) {
-        fprintf(stderr, "error: short write when writing to history file.\n");
+    /** enough to know whether the file is over its own limit as well */
+    if ((tail = __history_read_tail(history_fd, history_capacity > history_file_size ? history_capacity : history_file_size, &length,
+                                    &start, &lines, &more)) == NULL) {
+        fprintf(stderr, "error: unable to read history file.\n");
+        flock(history_fd, LOCK_UN);
         return 1;
     }
 
-    if (write(fileno(in_file), "\n", 1) != 1) {
-        fprintf(stderr, "error: short write when writing to history file.\n");
+    history_offset = lseek(history_fd, 0, SEEK_END);
+    flock(history_fd, LOCK_UN);
+
+    history_loaded = 1;
+    history_file_lines = more ? history_file_size + 1 : lines;
+
+    for (char *line = tail + start; line < tail + length; lines--) {
+        char *end = memchr(line, '\n', tail + length - line);
+        long size = end == NULL ? tail + length - line : end - line;
+
+        if (size > 0 && lines <= history_capacity) {
+            __history_push(strndup(line, size));
+        }
+
+        if (size > 0 && end != NULL) {
+            __history_set_last_line(line, size);
+        }
+
+        line += size + 1;
+    }
+
+    free(tail);
+
+    debug("loaded %d history entries\n", history_count);
+
+    if (history_file_lines > history_file_size) {
+        __history_compact_background();
+    }
+
+    return 0;
+}
+
+/**
+ * With $HISTSHARE set, merge in whatever other sessions appended since this one last looked.
+ * Only the new tail of the file is read.
+ */
+int internal_command_history_sync(void) {
+    if (!history_loaded || !history_share || history_file_size == 0) {
+        return 0;
+    }
+
+    if (__history_lock() != 0) {
+        return 1;
+    }
+
+    __history_read_new(lseek(history_fd, 0, SEEK_END));
+    flock(history_fd, LOCK_UN);
+
+    return 0;
+}
+
+/**
+ * Number of entries in the ring.
+ */
+int internal_command_history_count(void) {
+    return history_count;
+}
+
+/**
+ * The command of an entry, without its timestamp. Index 0 is the oldest entry in the ring.
+ */
+char *internal_command_history_command(int index) {
+    char *line = NULL;
+
+    if (index < 0 || index >= history_count) {
+        return NULL;
+    }
+
+    line = history_ring[(history_start + index) % history_capacity];
+
+    if (strlen(line) >= HISTORY_TIMESTAMP_LENGTH && line[HISTORY_TIMESTAMP_LENGTH - 3] == ' ' && line[HISTORY_TIMESTAMP_LENGTH - 2] == '$') {
+        return line + HISTORY_TIMESTAMP_LENGTH;
+    }
+
+    return line;
+}
+
+int internal_command_history(char *home_path, char *history_file) {
+    if (internal_command_history_load(home_path, history_file) != 0 || internal_command_history_sync() != 0) {
         return 1;
     }
 
-    fclose(in_file);
+    debug("wanting to print internal command history.\n");
+    for (int i = 0; i < history_count; i++) {
+        fprintf(stdout, "%-5d", i + 1);
+        fprintf(stdout, "%s\n", history_ring[(history_start + i) % history_capacity]);
+    }
 
     return 0;
 }
+
+/**
+ * Whether a line read at the prompt should be kept in the history at all.
+ */
+int __history_wanted(char *line) {
+    char *command = line;
+    char *previous = NULL;
+    int len;
+
+    while (isspace(*command)) {
+        command++;
+    }
+
+    len = strlen(command);
+
+    while (len > 0 && isspace(command[len - 1])) {
+        len--;
+    }
+
+    /** blank lines, comments & exit */
+    if (len == 0 || command[0] == '#' || (len == strlen(COMMAND_EXIT) && strncmp(command, COMMAND_EXIT, len) == 0)) {
+        return 0;
+    }
+
+    if (command != line && __history_control(HISTORY_IGNORE_SPACE)) {
+        return 0;
+    }
+
+    if (history_count > 0 && __history_control(HISTORY_IGNORE_DUPS)) {
+        previous = internal_command_history_command(history_count - 1);
+
+        if (strcmp(previous, line) == 0) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * Record a line read at the prompt, as controlled by $HISTCONTROL, $HISTSIZE & $HISTFILESIZE.
+ * Each record goes to the file in a single O_APPEND write, so records of parallel sessions never interleave.
+ */
+int internal_command_history_write(char *home_path, char *history_file, char *raw_cmd) {
+    time_t current_time;
+    char *record = NULL;
+    long record_len;
+    long long trace_start;
+    off_t end;
+    int ret = 0;
+
+    if (internal_command_history_load(home_path, history_file) != 0) {
+        return 1;
+    }
+
+    if (!__history_wanted(raw_cmd)) {
+        return 0;
+    }
+
+    trace_start = trace_begin();
+    record_len = HISTORY_TIMESTAMP_LENGTH + strlen(raw_cmd) + 1;
+
+    if ((record = malloc(record_len + 1)) == NULL) {
+        fprintf(stderr, "error: unable to allocate space for history record.\n");
+        return 1;
+    }
+
+    time(&current_time);
+    struct tm ts = *localtime(&current_time);
+    strftime(record, HISTORY_TIMESTAMP_LENGTH + 1, "%Y-%m-%d %H:%M:%S $ ", &ts);
+    sprintf(record + HISTORY_TIMESTAMP_LENGTH, "%s\n", raw_cmd);
+
+    if (history_file_size > 0) {
+        if (__history_lock() != 0) {
+            fprintf(stderr, "error: unable to open history file for writing: %s\n", history_path);
+            free(record);
+            return 1;
+        }
+
+        if (write(history_fd, record, record_len) != record_len) {
+            fprintf(stderr, "error: short write when writing to history file.\n");
+            ret = 1;
+        } else if (history_share) {
+            /** whatever other sessions appended just before this record comes first */
+            end = lseek(history_fd, 0, SEEK_CUR);
+            __history_read_new(end - record_len);
+
+            history_offset = end;
+            __history_set_last_line(record, record_len - 1);
+        }
+
+        flock(history_fd, LOCK_UN);
+        history_file_lines++;
+    }
+
+    record[record_len - 1] = NULL_CHAR;
+    __history_push(record);
+
+    trace_end(TRACE_HISTORY, NULL, trace_start);
+
+    /** let the file run over by half again before compacting, so it isn't rewritten on every command */
+    if (history_file_size > 0 && history_file_lines > history_file_size + history_file_size / 2) {
+        __history_compact_background();
+    }
+
+    return ret;
+}
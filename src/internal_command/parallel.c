@@ -0,0 +1,321 @@
+#include "internal_command/parallel.h"
+
+#include "executor.h"
+
+/**
+ * Where the items come from: the words after ':::', or the lines of a '< file'.
+ */
+typedef struct parallel_input {
+    string_list *command;
+    int next;  // index of the next item word in command, when there's no file
+
+    FILE *file;
+    char *line;
+    size_t line_size;
+} parallel_input;
+
+/**
+ * @returns the next item as a new string, or NULL once there are none left
+ */
+char *__parallel_next_item(parallel_input *input) {
+    ssize_t len;
+
+    if (input->file == NULL) {
+        return input->next < input->command->size ? strdup(input->command->strings[input->next++]) : NULL;
+    }
+
+    while ((len = getline(&input->line, &input->line_size, input->file)) != -1) {
+        if (len > 0 && input->line[len - 1] == '\n') {
+            input->line[--len] = NULL_CHAR;
+        }
+
+        /** blank lines aren't items */
+        if (len > 0) {
+            return strdup(input->line);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Copy of the token with every '{}' replaced by the item.
+ */
+char *__parallel_substitute(char *token, char *item) {
+    char *result = NULL;
+    char *at = NULL;
+    int count = 0;
+    int len = 0;
+
+    for (at = strstr(token, PARALLEL_ITEM_KEY); at != NULL; at = strstr(at + strlen(PARALLEL_ITEM_KEY), PARALLEL_ITEM_KEY)) {
+        count++;
+    }
+
+    if ((result = malloc(strlen(token) + count * strlen(item) + 1)) == NULL) {
+        return NULL;
+    }
+
+    while ((at = strstr(token, PARALLEL_ITEM_KEY)) != NULL) {
+        memcpy(result + len, token, at - token);
+        len += at - token;
+        memcpy(result + len, item, strlen(item));
+        len += strlen(item);
+        token = at + strlen(PARALLEL_ITEM_KEY);
+    }
+
+    strcpy(result + len, token);
+
+    return result;
+}
+
+/**
+ * Build the item's command line from the template.
+ */
+string_list *__parallel_command(string_list *template, char *item) {
+    string_list *command = NULL;
+    int substituted = 0;
+
+    if ((command = string_list_new()) == NULL) {
+        return NULL;
+    }
+
+    for (int i = 0; i < template->size; i++) {
+        char *token = NULL;
+
+        if (strstr(template->strings[i], PARALLEL_ITEM_KEY) == NULL) {
+            string_list_push(command, template->strings[i]);
+            continue;
+        }
+
+        if ((token = __parallel_substitute(template->strings[i], item)) == NULL) {
+            string_list_free(command);
+            return NULL;
+        }
+
+        string_list_push(command, token);
+        free(token);
+        substituted = 1;
+    }
+
+    if (substituted == 0) {
+        string_list_push(command, item);
+    }
+
+    return command;
+}
+
+/**
+ * Start the item's job in the slot; it runs in the background, so $? is left to parallel itself.
+ *
+ * @returns 0, or -1 if it couldn't be started (reported & counted as a failure)
+ */
+int __parallel_spawn(parallel_slot *slot, string_list *template, char *item, string_list *bin_list, job_limits *limits) {
+    string_list *command = NULL;
+    commander *cmd = NULL;
+
+    if ((command = __parallel_command(template, item)) == NULL || (cmd = parse_command_from_string_list(command)) == NULL) {
+        fprintf(stderr, "smash: parallel: unable to build the command for '%s'\n", item);
+        string_list_free(command);
+        return -1;
+    }
+
+    if ((cmd->bin_dir = executor_find_binary(cmd->bin, bin_list)) == NULL) {
+        fprintf(stderr, "smash: parallel: command not found: %s\n", cmd->bin);
+        parse_command_free(cmd);
+        string_list_free(command);
+        return -1;
+    }
+
+    cmd->bgfg = 1;
+
+    /** each job owns its limits, as it's freed on its own once it's finished with */
+    if (limits != NULL && (cmd->limits = malloc(sizeof(job_limits))) != NULL) {
+        memcpy(cmd->limits, limits, sizeof(job_limits));
+    }
+
+    metrics_start(&cmd->timing, metrics_enabled() ? string_list_string(command) : NULL);
+    cmd->timing.kind = METRICS_KIND_EXTERNAL;
+
+    executor_exec_bin_command(cmd, command);
+    string_list_free(command);
+
+    slot->cmd = cmd;
+    slot->item = item;
+
+    return 0;
+}
+
+/**
+ * Block until at least one of the jobs has been reaped.
+ */
+void __parallel_wait(parallel_slot *slots, int num_slots) {
+    /** a job without a pidfd is invisible to the reaper's epoll set, so wait on it directly */
+    for (int i = 0; i < num_slots; i++) {
+        if (slots[i].cmd != NULL && slots[i].cmd->running == 1 && slots[i].cmd->pidfd == -1) {
+            reaper_wait_job(slots[i].cmd);
+            return;
+        }
+    }
+
+    reaper_wait_any();
+}
+
+/**
+ * Report the item of each job that's finished, & free its slot.
+ *
+ * @returns the number of slots freed
+ */
+int __parallel_collect(parallel_slot *slots, int num_slots, int verbose, int *failed) {
+    int freed = 0;
+
+    for (int i = 0; i < num_slots; i++) {
+        if (slots[i].cmd == NULL || slots[i].cmd->running == 1) {
+            continue;
+        }
+
+        if (slots[i].cmd->exit_code != 0) {
+            (*failed)++;
+        }
+
+        if (verbose == 1 || slots[i].cmd->exit_code != 0) {
+            fprintf(stderr, "parallel: exit %d: %s\n", slots[i].cmd->exit_code, slots[i].item);
+        }
+
+        free(slots[i].item);
+        slots[i].cmd = NULL;
+        slots[i].item = NULL;
+        freed++;
+    }
+
+    return freed;
+}
+
+/**
+ * $ parallel [-j N] [-v] cmd args... ::: item...
+ * $ parallel [-j N] [-v] cmd args... < file
+ *
+ * @returns the number of items that failed, up to PARALLEL_MAX_FAILED
+ */
+int internal_command_parallel(string_list *command, string_list *bin_list, job_limits *limits) {
+    parallel_input input = {.command = command, .next = command->size};
+    parallel_slot *slots = NULL;
+    string_list *items = NULL;
+    string_list template = {.size = 0, .strings = NULL};
+    char *input_path = NULL;
+    char *item = NULL;
+    int num_slots = sysconf(_SC_NPROCESSORS_ONLN);
+    int running = 0;
+    int verbose = 0;
+    int failed = 0;
+    int i;
+
+    /** options come first */
+    for (i = 1; i < command->size && command->strings[i][0] == '-'; i++) {
+        if (strcmp(command->strings[i], "-v") == 0) {
+            verbose = 1;
+        } else if (strcmp(command->strings[i], "-j") == 0 && i + 1 < command->size) {
+            num_slots = atoi(command->strings[++i]);
+        } else if (strncmp(command->strings[i], "-j", 2) == 0 && command->strings[i][2] != NULL_CHAR) {
+            num_slots = atoi(command->strings[i] + 2);
+        } else {
+            fprintf(stderr, "smash: parallel: unknown option '%s'\n", command->strings[i]);
+            return 2;
+        }
+    }
+
+    if (num_slots < 1) {
+        fprintf(stderr, "smash: parallel: -j must be at least 1\n");
+        return 2;
+    }
+
+    /** the template runs up to ':::' or the '< file' of items; its own redirects stay with it */
+    template.strings = command->strings + i;
+
+    for (; i < command->size; i++) {
+        if (strcmp(command->strings[i], PARALLEL_ITEMS_KEY) == 0) {
+            input.next = i + 1;
+            break;
+        }
+
+        if (strncmp(command->strings[i], INPUT_REDIRECT_KEY, strlen(INPUT_REDIRECT_KEY)) == 0) {
+            input_path = command->strings[i][1] != NULL_CHAR ? command->strings[i] + 1 : i + 1 < command->size ? command->strings[i + 1] : NULL;
+            break;
+        }
+
+        template.size++;
+    }
+
+    if (template.size == 0) {
+        fprintf(stderr, "usage: parallel [-j N] [-v] cmd [args...] ::: item... | < file\n");
+        return 2;
+    }
+
+    if (input_path == NULL && input.next == command->size) {
+        fprintf(stderr, "smash: parallel: no items; give them after '%s' or from '< file'\n", PARALLEL_ITEMS_KEY);
+        return 2;
+    }
+
+    if (input_path != NULL && (input.file = fopen(input_path, "re")) == NULL) {
+        fprintf(stderr, "smash: parallel: unable to open '%s'\n", input_path);
+        return 2;
+    }
+
+    /** items are paths as often as not, e.g.) '::: *.log', so they're expanded like any other arguments */
+    if (input_path == NULL && (items = string_list_new()) != NULL) {
+        for (i = input.next; i < command->size; i++) {
+            if (!glob_expand_has_magic(command->strings[i]) || glob_expand(command->strings[i], items) == 0) {
+                string_list_push(items, command->strings[i]);
+            }
+        }
+
+        input.command = items;
+        input.next = 0;
+    }
+
+    if ((slots = calloc(num_slots, sizeof(parallel_slot))) == NULL) {
+        debug("error: unable to allocate space for parallel slots\n");
+
+        if (input.file != NULL) {
+            fclose(input.file);
+        }
+
+        string_list_free(items);
+
+        return 2;
+    }
+
+    /** fill every free slot, then refill as each job is reaped */
+    while (1) {
+        for (int slot = 0; running < num_slots && slot < num_slots; slot++) {
+            if (slots[slot].cmd != NULL || (item = __parallel_next_item(&input)) == NULL) {
+                continue;
+            }
+
+            if (__parallel_spawn(&slots[slot], &template, item, bin_list, limits) != 0) {
+                free(item);
+                failed++;
+                slot--;
+                continue;
+            }
+
+            running++;
+        }
+
+        if (running == 0) {
+            break;
+        }
+
+        __parallel_wait(slots, num_slots);
+        running -= __parallel_collect(slots, num_slots, verbose, &failed);
+    }
+
+    free(slots);
+    free(input.line);
+    string_list_free(items);
+
+    if (input.file != NULL) {
+        fclose(input.file);
+    }
+
+    return failed > PARALLEL_MAX_FAILED ? PARALLEL_MAX_FAILED : failed;
+}
@@ -1,9 +1,62 @@
 #include "internal_command/pwd.h"
 
+/** the shell's current directory, tracked in memory so the prompt never has to ask the kernel */
+static char *current_path;
+static dev_t current_dev;
+static ino_t current_ino;
+
+/**
+ * Re-read the current directory; called after the shell changes directory.
+ * No fixed size buffer, so deep paths work.
+ */
+int internal_command_pwd_update(void) {
+    struct stat st;
+    char *path = NULL;
+
+    if ((path = getcwd(NULL, 0)) == NULL) {
+        return 1;
+    }
+
+    free(current_path);
+    current_path = path;
+
+    if (stat(current_path, &st) == 0) {
+        current_dev = st.st_dev;
+        current_ino = st.st_ino;
+    }
+
+    return 0;
+}
+
+/**
+ * @returns the tracked current directory, or NULL if it couldn't be determined
+ */
+char *internal_command_pwd_current(void) {
+    if (current_path == NULL) {
+        internal_command_pwd_update();
+    }
+
+    return current_path;
+}
+
+/**
+ * Check that the tracked path still names the current directory;
+ * it may have been renamed or removed from under the shell.
+ */
+void __pwd_revalidate(void) {
+    struct stat cached, actual;
+
+    if (current_path == NULL || stat(current_path, &cached) != 0 || stat(".", &actual) != 0 ||
+        cached.st_dev != actual.st_dev || cached.st_ino != actual.st_ino ||
+        cached.st_dev != current_dev || cached.st_ino != current_ino) {
+        internal_command_pwd_update();
+    }
+}
+
 int internal_command_pwd(void) {
-    char current_path[MAX_PATH];
+    __pwd_revalidate();
 
-    if (getcwd(current_path, MAX_PATH) == NULL) {
+    if (current_path == NULL) {
         return 1;
     }
 
@@ -0,0 +1,57 @@
+#include "internal_command/ulimit.h"
+
+/**
+ * $ ulimit [-a] [-FLAG [VALUE]]...
+ * Prints or sets the shell-wide default resource limits, applied to every job started afterwards.
+ */
+int internal_command_ulimit(string_list *command) {
+    job_limits *limits = NULL;
+    int i = 1;
+
+    if ((limits = job_limits_new()) == NULL) {
+        return 1;
+    }
+
+    /** like other shells, no arguments means the file size limit */
+    if (command->size == 1) {
+        job_limits_print(job_limits_resource_by_flag('f'));
+    }
+
+    while (i < command->size) {
+        job_limits_resource *resource = NULL;
+        char *arg = command->strings[i];
+
+        if (strcmp(arg, "-a") == 0) {
+            for (resource = job_limits_resources(); resource->name != NULL; resource++) {
+                job_limits_print(resource);
+            }
+
+            i++;
+            continue;
+        }
+
+        if (arg[0] != '-' || strlen(arg) != 2 || (resource = job_limits_resource_by_flag(arg[1])) == NULL) {
+            fprintf(stderr, "smash: ulimit: invalid option: '%s'\n", arg);
+            free(limits);
+            return 1;
+        }
+
+        /** a flag followed by a value sets the limit, a flag alone prints it */
+        if (i + 1 < command->size && command->strings[i + 1][0] != '-') {
+            if (job_limits_set_rlimit(limits, resource, command->strings[i + 1]) != 0) {
+                free(limits);
+                return 1;
+            }
+
+            i += 2;
+        } else {
+            job_limits_print(resource);
+            i++;
+        }
+    }
+
+    job_limits_set_defaults(limits);
+    free(limits);
+
+    return 0;
+}
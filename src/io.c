@@ -1,21 +1,281 @@
 #include "io.h"
 
+/** the kernel's record layout for getdents64 */
+typedef struct __linux_dirent64 {
+    unsigned long long d_ino;
+    long long d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+} __linux_dirent64;
+
+static io_dir *io_dir_table[IO_DIR_BUCKETS];
+
+/** bumped on every read, so a listing that was read again never has the same generation */
+static unsigned long io_dir_generation = 0;
+
+/** bumped on every listing, to tell which was used least recently */
+static unsigned long io_dir_clock = 0;
+
+static int io_dir_cached = 0;
+static long io_dir_names = 0;
+
+/**
+ * FNV-1a hash of the directory path.
+ */
+unsigned int __io_dir_hash(char *path) {
+    unsigned int hash = 2166136261u;
+
+    while (*path != '\0') {
+        hash ^= (unsigned char)*path++;
+        hash *= 16777619u;
+    }
+
+    return hash % IO_DIR_BUCKETS;
+}
+
+int __io_dir_entry_compare(const void *a, const void *b) {
+    return strcmp(((io_dir_entry *)a)->name, ((io_dir_entry *)b)->name);
+}
+
+/**
+ * (Re-)read the listing of dir from the open directory fd.
+ */
+int __io_dir_read(io_dir *dir, int fd) {
+    char *names = NULL;
+    io_dir_entry *entries = NULL;
+    long names_used = 0;
+    long names_size = IO_DIR_READ_SIZE;
+    int count = 0;
+    int entries_size = 64;
+    char buf[IO_DIR_READ_SIZE];
+    long nread;
+
+    if ((names = malloc(names_size)) == NULL || (entries = malloc(entries_size * sizeof(io_dir_entry))) == NULL) {
+        debug("error: unable to allocate space for directory listing\n");
+        free(names);
+        return -1;
+    }
+
+    while ((nread = syscall(SYS_getdents64, fd, buf, sizeof(buf))) > 0) {
+        for (long off = 0; off < nread;) {
+            __linux_dirent64 *de = (__linux_dirent64 *)(buf + off);
+            long len = strlen(de->d_name) + 1;
+
+            off += de->d_reclen;
+
+            if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0) {
+                continue;
+            }
+
+            if (names_used + len > names_size) {
+                char *new_names = NULL;
+
+                names_size <<= 1;
+
+                if ((new_names = realloc(names, names_size)) == NULL) {
+                    free(names);
+                    free(entries);
+                    return -1;
+                }
+
+                names = new_names;
+            }
+
+            if (count == entries_size) {
+                io_dir_entry *new_entries = NULL;
+
+                entries_size <<= 1;
+
+                if ((new_entries = realloc(entries, entries_size * sizeof(io_dir_entry))) == NULL) {
+                    free(names);
+                    free(entries);
+                    return -1;
+                }
+
+                entries = new_entries;
+            }
+
+            memcpy(names + names_used, de->d_name, len);
+
+            /** an offset for now, since names may still move */
+            entries[count].name = (char *)names_used;
+            entries[count].type = de->d_type;
+
+            names_used += len;
+            count++;
+        }
+    }
+
+    if (nread < 0) {
+        debug("error: getdents64 failed on '%s'\n", dir->path);
+        free(names);
+        free(entries);
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        entries[i].name = names + (long)entries[i].name;
+    }
+
+    qsort(entries, count, sizeof(io_dir_entry), __io_dir_entry_compare);
+
+    free(dir->names);
+    free(dir->entries);
+
+    io_dir_names += count - dir->count;
+
+    dir->names = names;
+    dir->entries = entries;
+    dir->count = count;
+    dir->generation = ++io_dir_generation;
+
+    debug("read %d entries of '%s'\n", count, dir->path);
+
+    return 0;
+}
+
+/**
+ * The listing of a directory; only read from disk the first time, or once the directory has changed since.
+ *
+ * @returns
+ * the listing, owned by the cache, or NULL if the directory can't be read.
+ */
+io_dir *io_dir_list(char *path) {
+    unsigned int bucket = __io_dir_hash(path);
+    io_dir *dir = NULL;
+    struct stat st;
+    int fd = -1;
+
+    for (dir = io_dir_table[bucket]; dir != NULL; dir = dir->next) {
+        if (strcmp(dir->path, path) == 0) {
+            break;
+        }
+    }
+
+    if (stat(path, &st) == -1 || !S_ISDIR(st.st_mode)) {
+        return NULL;
+    }
+
+    if (dir != NULL) {
+        dir->last_used = ++io_dir_clock;
+    }
+
+    if (dir != NULL && dir->names != NULL && dir->dev == st.st_dev && dir->ino == st.st_ino &&
+        dir->mtime.tv_sec == st.st_mtim.tv_sec && dir->mtime.tv_nsec == st.st_mtim.tv_nsec) {
+        return dir;
+    }
+
+    if (dir == NULL) {
+        if ((dir = calloc(1, sizeof(io_dir))) == NULL || (dir->path = strdup(path)) == NULL) {
+            debug("error: unable to allocate space for directory listing\n");
+            free(dir);
+            return NULL;
+        }
+
+        dir->last_used = ++io_dir_clock;
+        dir->next = io_dir_table[bucket];
+        io_dir_table[bucket] = dir;
+        io_dir_cached++;
+    }
+
+    if ((fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) == -1) {
+        return NULL;
+    }
+
+    /** stat'd before reading, so a change made while reading is picked up next time */
+    dir->dev = st.st_dev;
+    dir->ino = st.st_ino;
+    dir->mtime = st.st_mtim;
+
+    if (__io_dir_read(dir, fd) != 0) {
+        dir->mtime.tv_sec = 0;
+        dir->mtime.tv_nsec = 0;
+        close(fd);
+
+        return dir->names != NULL ? dir : NULL;
+    }
+
+    close(fd);
+
+    return dir;
+}
+
+/**
+ * Binary search for the names in a listing that start with prefix.
+ *
+ * @returns
+ * how many names match; *first is set to the index of the first of them.
+ */
+int io_dir_prefix(io_dir *dir, char *prefix, int *first) {
+    int len = strlen(prefix);
+    int low = 0;
+    int high = dir->count;
+    int end;
+
+    while (low < high) {
+        int mid = (low + high) / 2;
+
+        if (strcmp(dir->entries[mid].name, prefix) < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    for (end = low; end < dir->count && strncmp(dir->entries[end].name, prefix, len) == 0; end++) {
+    }
+
+    *first = low;
+
+    return end - low;
+}
+
+/**
+ * Drop the least recently used listings until the cache is within its bounds.
+ * Any listing may be freed, so this must not be called while one is still in use.
+ */
+void io_dir_trim(void) {
+    while (io_dir_cached > IO_DIR_MAX_CACHED || io_dir_names > IO_DIR_MAX_NAMES) {
+        io_dir **oldest = NULL;
+        io_dir *dir = NULL;
+
+        for (int i = 0; i < IO_DIR_BUCKETS; i++) {
+            for (io_dir **link = &io_dir_table[i]; *link != NULL; link = &(*link)->next) {
+                if (oldest == NULL || (*link)->last_used < (*oldest)->last_used) {
+                    oldest = link;
+                }
+            }
+        }
+
+        dir = *oldest;
+        *oldest = dir->next;
+
+        debug("dropped the listing of '%s' from the cache\n", dir->path);
+
+        io_dir_cached--;
+        io_dir_names -= dir->count;
+
+        free(dir->path);
+        free(dir->names);
+        free(dir->entries);
+        free(dir);
+    }
+}
+
 void io_print_files_in_dir(char *path) {
-    struct dirent *de = NULL;
-    DIR *dr = NULL;
+    io_dir *dir = NULL;
+
+    io_dir_trim();
 
-    if ((dr = opendir(path)) == NULL) {
+    if ((dir = io_dir_list(path)) == NULL) {
         fprintf(stderr, "error: could not open specified directory.\n");
         return;
     }
 
-    while ((de = readdir(dr)) != NULL) {
-        if (strcmp(de->d_name, "..") != 0 && strcmp(de->d_name, ".") != 0) {
-            printf("%s\n", de->d_name);
-        }
+    for (int i = 0; i < dir->count; i++) {
+        printf("%s\n", dir->entries[i].name);
     }
 
-    closedir(dr);
-
     return;
 }
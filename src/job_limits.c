@@ -0,0 +1,315 @@
+#define _GNU_SOURCE
+
+#include "job_limits.h"
+
+#include <sched.h>
+
+static const char JOB_LIMITS_PREFIX_KEY = '@';
+static const char *JOB_LIMITS_CPUS_KEY = "cpus";
+static const char *JOB_LIMITS_NICE_KEY = "nice";
+static const char *JOB_LIMITS_UNLIMITED = "unlimited";
+
+static job_limits_resource JOB_LIMITS_RESOURCES[] = {
+    {'c', "core", RLIMIT_CORE, 1024, "core file size (kbytes)"},
+    {'d', "data", RLIMIT_DATA, 1024, "data seg size (kbytes)"},
+    {'f', "fsize", RLIMIT_FSIZE, 1024, "file size (kbytes)"},
+    {'l', "memlock", RLIMIT_MEMLOCK, 1024, "max locked memory (kbytes)"},
+    {'n', "nofile", RLIMIT_NOFILE, 1, "open files"},
+    {'s', "stack", RLIMIT_STACK, 1024, "stack size (kbytes)"},
+    {'t', "cpu", RLIMIT_CPU, 1, "cpu time (seconds)"},
+    {'u', "nproc", RLIMIT_NPROC, 1, "max user processes"},
+    {'v', "as", RLIMIT_AS, 1024, "virtual memory (kbytes)"},
+    {0, NULL, 0, 0, NULL},
+};
+
+/** Shell-wide defaults, applied to every job unless the job overrides them */
+static job_limits *defaults;
+
+job_limits *job_limits_new() {
+    job_limits *limits = NULL;
+
+    if ((limits = calloc(1, sizeof(job_limits))) == NULL) {
+        debug("error: unable to allocate space for job limits\n");
+        return NULL;
+    }
+
+    return limits;
+}
+
+job_limits *job_limits_defaults() {
+    if (defaults == NULL) {
+        defaults = job_limits_new();
+    }
+
+    return defaults;
+}
+
+/**
+ * @returns the table of supported resources, terminated by an entry with a NULL name
+ */
+job_limits_resource *job_limits_resources() {
+    return JOB_LIMITS_RESOURCES;
+}
+
+job_limits_resource *job_limits_resource_by_flag(char flag) {
+    for (job_limits_resource *resource = JOB_LIMITS_RESOURCES; resource->name != NULL; resource++) {
+        if (resource->flag == flag) {
+            return resource;
+        }
+    }
+
+    return NULL;
+}
+
+job_limits_resource *__job_limits_resource_by_name(char *name) {
+    for (job_limits_resource *resource = JOB_LIMITS_RESOURCES; resource->name != NULL; resource++) {
+        if (strcmp(resource->name, name) == 0) {
+            return resource;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Set both the soft and hard limit of a resource, from a value in the resource's unit or 'unlimited'.
+ */
+int job_limits_set_rlimit(job_limits *limits, job_limits_resource *resource, char *value) {
+    char *end = NULL;
+    rlim_t limit;
+
+    if (strcmp(value, JOB_LIMITS_UNLIMITED) == 0) {
+        limit = RLIM_INFINITY;
+    } else {
+        errno = 0;
+        limit = strtoull(value, &end, 10) * resource->unit;
+
+        if (errno != 0 || end == value || *end != '\0') {
+            fprintf(stderr, "smash: invalid %s limit: '%s'\n", resource->name, value);
+            return -1;
+        }
+    }
+
+    limits->has_rlimit[resource->resource] = 1;
+    limits->rlimits[resource->resource].rlim_cur = limit;
+    limits->rlimits[resource->resource].rlim_max = limit;
+
+    return 0;
+}
+
+/**
+ * Parse a list of cpus such as '0-3,6,8-9' into the limits' cpu mask.
+ */
+int __job_limits_set_cpus(job_limits *limits, char *value) {
+    char *pos = value;
+
+    memset(limits->cpus, 0, sizeof(limits->cpus));
+
+    while (*pos != '\0') {
+        char *end = NULL;
+        long first = strtol(pos, &end, 10);
+        long last = first;
+
+        if (end == pos) {
+            break;
+        }
+
+        if (*end == '-') {
+            pos = end + 1;
+            last = strtol(pos, &end, 10);
+
+            if (end == pos) {
+                break;
+            }
+        }
+
+        if (first < 0 || last < first || last >= JOB_LIMITS_MAX_CPUS) {
+            break;
+        }
+
+        for (long cpu = first; cpu <= last; cpu++) {
+            limits->cpus[cpu / 8] |= 1 << (cpu % 8);
+        }
+
+        if (*end == '\0') {
+            limits->has_cpus = 1;
+            return 0;
+        }
+
+        if (*end != ',') {
+            break;
+        }
+
+        pos = end + 1;
+    }
+
+    fprintf(stderr, "smash: invalid cpu list: '%s'\n", value);
+
+    return -1;
+}
+
+/**
+ * Parse a single '@key=value' prefix into the limits.
+ */
+int __job_limits_parse_prefix(job_limits *limits, char *token) {
+    job_limits_resource *resource = NULL;
+    char *key = strndup(token + 1, strcspn(token + 1, "="));
+    char *value = token + 1 + strlen(key) + 1;
+    int ret = 0;
+
+    if (strcmp(key, JOB_LIMITS_CPUS_KEY) == 0) {
+        ret = __job_limits_set_cpus(limits, value);
+    } else if (strcmp(key, JOB_LIMITS_NICE_KEY) == 0) {
+        char *end = NULL;
+
+        limits->has_nice = 1;
+        limits->nice = strtol(value, &end, 10);
+
+        if (end == value || *end != '\0') {
+            fprintf(stderr, "smash: invalid nice value: '%s'\n", value);
+            ret = -1;
+        }
+    } else if ((resource = __job_limits_resource_by_name(key)) != NULL) {
+        ret = job_limits_set_rlimit(limits, resource, value);
+    } else {
+        fprintf(stderr, "smash: unknown job limit: '%s'\n", token);
+        ret = -1;
+    }
+
+    free(key);
+
+    return ret;
+}
+
+/**
+ * Parse the leading '@key=value' prefixes of a command.
+ *
+ * @returns the number of prefix tokens (*limits is then set to the parsed limits), or -1 if one was invalid
+ */
+int job_limits_parse_prefixes(string_list *command, job_limits **limits) {
+    int i;
+
+    *limits = NULL;
+
+    for (i = 0; i < command->size; i++) {
+        char *token = command->strings[i];
+
+        if (token[0] != JOB_LIMITS_PREFIX_KEY || strchr(token, '=') == NULL) {
+            break;
+        }
+
+        if (*limits == NULL && (*limits = job_limits_new()) == NULL) {
+            return -1;
+        }
+
+        if (__job_limits_parse_prefix(*limits, token) != 0) {
+            free(*limits);
+            *limits = NULL;
+
+            return -1;
+        }
+    }
+
+    return i;
+}
+
+/**
+ * Make the given limits the defaults for all later jobs (on top of any earlier defaults).
+ */
+void job_limits_set_defaults(job_limits *limits) {
+    job_limits *current = job_limits_defaults();
+
+    if (limits->has_nice == 1) {
+        current->has_nice = 1;
+        current->nice = limits->nice;
+    }
+
+    if (limits->has_cpus == 1) {
+        current->has_cpus = 1;
+        memcpy(current->cpus, limits->cpus, sizeof(current->cpus));
+    }
+
+    for (int i = 0; i < RLIMIT_NLIMITS; i++) {
+        if (limits->has_rlimit[i] == 1) {
+            current->has_rlimit[i] = 1;
+            current->rlimits[i] = limits->rlimits[i];
+        }
+    }
+}
+
+/**
+ * Apply the job's limits, falling back to the shell-wide defaults, to the calling process.
+ * Called in the child after fork, just before exec.
+ */
+void job_limits_apply(job_limits *limits) {
+    job_limits *fallback = job_limits_defaults();
+    job_limits none = {0};
+
+    if (limits == NULL) {
+        limits = &none;
+    }
+
+    if (fallback == NULL) {
+        fallback = &none;
+    }
+
+    job_limits *nice = limits->has_nice == 1 ? limits : fallback;
+
+    if (nice->has_nice == 1) {
+        errno = 0;
+        int current = getpriority(PRIO_PROCESS, 0);
+
+        if (errno != 0 || setpriority(PRIO_PROCESS, 0, current + nice->nice) != 0) {
+            fprintf(stderr, "smash: unable to set nice value: %s\n", strerror(errno));
+        }
+    }
+
+    job_limits *cpus = limits->has_cpus == 1 ? limits : fallback;
+
+    if (cpus->has_cpus == 1) {
+        cpu_set_t set;
+
+        CPU_ZERO(&set);
+
+        for (int cpu = 0; cpu < JOB_LIMITS_MAX_CPUS && cpu < CPU_SETSIZE; cpu++) {
+            if (cpus->cpus[cpu / 8] & (1 << (cpu % 8))) {
+                CPU_SET(cpu, &set);
+            }
+        }
+
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+            fprintf(stderr, "smash: unable to set cpu affinity: %s\n", strerror(errno));
+        }
+    }
+
+    for (int i = 0; i < RLIMIT_NLIMITS; i++) {
+        job_limits *rlimit = limits->has_rlimit[i] == 1 ? limits : fallback;
+
+        if (rlimit->has_rlimit[i] == 1 && setrlimit(i, &rlimit->rlimits[i]) != 0) {
+            fprintf(stderr, "smash: unable to set resource limit %d: %s\n", i, strerror(errno));
+        }
+    }
+}
+
+/**
+ * Print the default limit of a resource, or the shell's own limit when no default was set.
+ */
+void job_limits_print(job_limits_resource *resource) {
+    job_limits *current = job_limits_defaults();
+    struct rlimit limit;
+
+    if (current != NULL && current->has_rlimit[resource->resource] == 1) {
+        limit = current->rlimits[resource->resource];
+    } else if (getrlimit(resource->resource, &limit) != 0) {
+        fprintf(stderr, "smash: unable to get resource limit: %s\n", strerror(errno));
+        return;
+    }
+
+    fprintf(stdout, "%-28s (-%c) ", resource->description, resource->flag);
+
+    if (limit.rlim_cur == RLIM_INFINITY) {
+        fprintf(stdout, "%s\n", JOB_LIMITS_UNLIMITED);
+    } else {
+        fprintf(stdout, "%llu\n", (unsigned long long)(limit.rlim_cur / resource->unit));
+    }
+}
@@ -0,0 +1,280 @@
+#define _GNU_SOURCE
+
+#include "job_output.h"
+
+/** read end of every open stream; the epoll data of each is its job_output_stream */
+static int output_epoll = -1;
+
+/** streams not yet at EOF; a job's stay open until every process holding the pipe has let go of it */
+static int output_streams = 0;
+
+/** only the shell itself drains the streams; forked children have a copy of the epoll set */
+static pid_t output_owner = -1;
+
+/**
+ * Create the epoll set of streams, which the reaper nests in its own.
+ *
+ * @returns the epoll set's fd, or -1 on error
+ */
+int job_output_init(void) {
+    if ((output_epoll = epoll_create1(EPOLL_CLOEXEC)) == -1) {
+        debug("error: unable to create job output epoll set: %d\n", errno);
+        return -1;
+    }
+
+    /** once in each process; a subshell starts with none of the shell's streams */
+    if (output_owner == -1) {
+        atexit(job_output_finish);
+    }
+
+    output_owner = getpid();
+    output_streams = 0;
+
+    return output_epoll;
+}
+
+/**
+ * Whether background jobs started now should have their output multiplexed.
+ */
+int job_output_enabled(void) {
+    char *mode = NULL;
+    int enabled;
+
+    if (output_epoll == -1 || (mode = parse_path_get_env(ENV_JOB_OUTPUT_KEY)) == NULL) {
+        return 0;
+    }
+
+    enabled = strcmp(mode, JOB_OUTPUT_PREFIX) == 0;
+    free(mode);
+
+    return enabled;
+}
+
+/**
+ * Write out a line of the stream with the job's prefix, as one write so it can't be split by another.
+ */
+void __job_output_emit(job_output_stream *stream, int newline) {
+    char prefix[24];
+    struct iovec iov[3];
+    int num_iov = 2;
+
+    iov[0].iov_base = prefix;
+    iov[0].iov_len = sprintf(prefix, "[%d] ", stream->job_id);
+    iov[1].iov_base = stream->line;
+    iov[1].iov_len = stream->len;
+
+    if (newline == 1) {
+        iov[num_iov].iov_base = "\n";
+        iov[num_iov++].iov_len = 1;
+    }
+
+    if (writev(stream->target, iov, num_iov) == -1) {
+        debug("error: unable to write job output: %d\n", errno);
+    }
+
+    stream->len = 0;
+}
+
+/**
+ * The stream's pipe has been closed by the job; write out its unfinished line & let go of it.
+ */
+void __job_output_close(job_output_stream *stream) {
+    if (stream->len > 0) {
+        __job_output_emit(stream, 1);
+    }
+
+    epoll_ctl(output_epoll, EPOLL_CTL_DEL, stream->fd, NULL);
+    close(stream->fd);
+    free(stream);
+
+    output_streams--;
+}
+
+/**
+ * Read what's in the stream's pipe, writing out each complete line as it's found.
+ * Reads no more than the line buffer has room for at a time, so the shell never holds more than a line of it.
+ */
+void __job_output_read(job_output_stream *stream) {
+    ssize_t num_read;
+    char *newline = NULL;
+
+    while ((num_read = read(stream->fd, stream->line + stream->len, JOB_OUTPUT_LINE_MAX - stream->len)) > 0) {
+        int start = stream->len;
+
+        stream->len += num_read;
+
+        while ((newline = memchr(stream->line + start, '\n', stream->len - start)) != NULL) {
+            int rest = stream->len - (newline - stream->line) - 1;
+
+            stream->len = newline - stream->line;
+            __job_output_emit(stream, 1);
+
+            memmove(stream->line, newline + 1, rest);
+            stream->len = rest;
+            start = 0;
+        }
+
+        /** a line too long for the buffer goes out in pieces */
+        if (stream->len == JOB_OUTPUT_LINE_MAX) {
+            __job_output_emit(stream, 0);
+        }
+    }
+
+    if (num_read == 0 || (num_read == -1 && errno != EAGAIN && errno != EINTR)) {
+        __job_output_close(stream);
+    }
+}
+
+/**
+ * Give the job pipes for its stdout & stderr, & start draining them. Called before it's forked.
+ *
+ * @returns 0, or -1 if the job should just inherit the shell's output
+ */
+int job_output_open(commander *cmd) {
+    int fds[2][2];
+
+    if (pipe2(fds[0], O_CLOEXEC) == -1) {
+        return -1;
+    }
+
+    if (pipe2(fds[1], O_CLOEXEC) == -1) {
+        close(fds[0][0]);
+        close(fds[0][1]);
+        return -1;
+    }
+
+    for (int i = 0; i < 2; i++) {
+        job_output_stream *stream = NULL;
+        struct epoll_event event;
+
+        /** a chatty job fills this & blocks, rather than the shell buffering it all */
+        fcntl(fds[i][0], F_SETPIPE_SZ, JOB_OUTPUT_PIPE_SIZE);
+        fcntl(fds[i][0], F_SETFL, O_NONBLOCK);
+
+        if ((stream = malloc(sizeof(job_output_stream))) == NULL) {
+            debug("error: unable to allocate space for job output stream\n");
+            close(fds[i][0]);
+            cmd->output_fd[i] = fds[i][1];
+            continue;
+        }
+
+        stream->fd = fds[i][0];
+        stream->target = i == 0 ? STDOUT_FILENO : STDERR_FILENO;
+        stream->job_id = cmd->job_id;
+        stream->len = 0;
+
+        event.events = EPOLLIN;
+        event.data.ptr = stream;
+
+        if (epoll_ctl(output_epoll, EPOLL_CTL_ADD, stream->fd, &event) == -1) {
+            debug("error: unable to watch job output: %d\n", errno);
+            close(stream->fd);
+            free(stream);
+        } else {
+            output_streams++;
+        }
+
+        cmd->output_fd[i] = fds[i][1];
+    }
+
+    return 0;
+}
+
+/**
+ * In the forked job, replace stdout & stderr with the pipes. Its own redirects are applied afterwards, so they still win.
+ */
+void job_output_redirect(commander *cmd) {
+    if (cmd->output_fd[0] == -1) {
+        return;
+    }
+
+    dup2(cmd->output_fd[0], STDOUT_FILENO);
+    dup2(cmd->output_fd[1], STDERR_FILENO);
+}
+
+/**
+ * In the shell, once the job's forked: only the job holds the write ends, so its pipes close when it does.
+ */
+void job_output_close_writers(commander *cmd) {
+    for (int i = 0; i < 2; i++) {
+        if (cmd->output_fd[i] != -1) {
+            close(cmd->output_fd[i]);
+            cmd->output_fd[i] = -1;
+        }
+    }
+}
+
+/**
+ * Write out the complete lines of every stream with something to read, without blocking.
+ */
+void job_output_drain(void) {
+    struct epoll_event events[JOB_OUTPUT_MAX_EVENTS];
+    int num_events;
+
+    if (output_streams == 0 || getpid() != output_owner) {
+        return;
+    }
+
+    while ((num_events = epoll_wait(output_epoll, events, JOB_OUTPUT_MAX_EVENTS, 0)) > 0) {
+        for (int i = 0; i < num_events; i++) {
+            __job_output_read(events[i].data.ptr);
+        }
+
+        if (num_events < JOB_OUTPUT_MAX_EVENTS) {
+            break;
+        }
+    }
+}
+
+/**
+ * Write out whatever the streams have to read, waiting at most timeout ms (-1 for ever) for each batch of it.
+ * Stops once every stream is closed, or nothing more turns up in time.
+ */
+void __job_output_forward(int timeout) {
+    struct epoll_event events[JOB_OUTPUT_MAX_EVENTS];
+    int num_events;
+
+    while (output_streams > 0) {
+        if ((num_events = epoll_wait(output_epoll, events, JOB_OUTPUT_MAX_EVENTS, timeout)) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            break;
+        }
+
+        if (num_events == 0) {
+            break;
+        }
+
+        for (int i = 0; i < num_events; i++) {
+            __job_output_read(events[i].data.ptr);
+        }
+    }
+}
+
+/**
+ * On exit, write out what the jobs have written so far, without waiting for them to finish.
+ * Jobs that outlive the shell have their streams handed to a detached process, which keeps writing out their lines
+ * until they close them, so they're neither blocked by a full pipe nor killed by a closed one.
+ */
+void job_output_finish(void) {
+    if (getpid() != output_owner) {
+        return;
+    }
+
+    fflush(stdout);
+
+    __job_output_forward(JOB_OUTPUT_FINISH_WAIT_MS);
+
+    if (output_streams == 0 || fork() != 0) {
+        return;
+    }
+
+    setsid();
+    output_owner = getpid();
+
+    __job_output_forward(-1);
+
+    _exit(0);
+}
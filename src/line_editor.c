@@ -0,0 +1,577 @@
+#include "line_editor.h"
+
+#define CTRL_KEY(k) ((k) & 0x1f)
+#define KEY_ESC 27
+#define KEY_BACKSPACE 127
+
+/** the terminal's settings from before raw mode, restored after each line & at exit */
+static struct termios original_termios;
+static int raw_enabled = 0;
+static int restore_registered = 0;
+
+/** the last killed text, shared between lines */
+static char *yank_buf = NULL;
+
+/**
+ * Make sure *buf can hold needed bytes.
+ */
+int __line_editor_grow(char **buf, int *size, int needed) {
+    char *new_buf = NULL;
+    int new_size = *size > 0 ? *size : 64;
+
+    if (needed <= *size) {
+        return 0;
+    }
+
+    while (new_size < needed) {
+        new_size <<= 1;
+    }
+
+    if ((new_buf = realloc(*buf, new_size)) == NULL) {
+        fprintf(stderr, "error: unable to realloc for line editor buffer\n");
+        return -1;
+    }
+
+    *buf = new_buf;
+    *size = new_size;
+
+    return 0;
+}
+
+void __line_editor_raw_disable(void) {
+    if (raw_enabled) {
+        tcsetattr(fileno(stdin), TCSADRAIN, &original_termios);
+        raw_enabled = 0;
+    }
+}
+
+/**
+ * Turn off echo, line buffering & signal keys, so that every key press reaches the editor as it's typed.
+ * Output processing is left on, so '\n' still moves to the start of the next line.
+ */
+int __line_editor_raw_enable(int fd) {
+    struct termios raw;
+
+    if (tcgetattr(fd, &original_termios) == -1) {
+        return -1;
+    }
+
+    if (!restore_registered) {
+        atexit(__line_editor_raw_disable);
+        restore_registered = 1;
+    }
+
+    raw = original_termios;
+    raw.c_iflag &= ~(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+    raw.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+
+    /** TCSADRAIN rather than TCSAFLUSH, so type-ahead isn't thrown away */
+    if (tcsetattr(fd, TCSADRAIN, &raw) == -1) {
+        return -1;
+    }
+
+    raw_enabled = 1;
+
+    return 0;
+}
+
+void __line_editor_out(line_editor *ed, const char *str, int len) {
+    if (len == 0 || __line_editor_grow(&ed->out, &ed->out_size, ed->out_len + len) != 0) {
+        return;
+    }
+
+    memcpy(ed->out + ed->out_len, str, len);
+    ed->out_len += len;
+}
+
+void __line_editor_flush(line_editor *ed) {
+    int written = 0;
+
+    while (written < ed->out_len) {
+        int ret = write(fileno(stdout), ed->out + written, ed->out_len - written);
+
+        if (ret <= 0) {
+            break;
+        }
+
+        written += ret;
+    }
+
+    ed->out_len = 0;
+}
+
+/**
+ * Move the terminal's cursor within the drawn line.
+ */
+void __line_editor_move(line_editor *ed, int to) {
+    char seq[16];
+    int n = to - ed->shown_pos;
+
+    if (n == 0) {
+        return;
+    }
+
+    if (n == -1) {
+        __line_editor_out(ed, "\b", 1);
+    } else if (n == 1) {
+        /** re-drawing the cell is shorter than an escape sequence */
+        __line_editor_out(ed, ed->shown + ed->shown_pos, 1);
+    } else if (n < 0) {
+        __line_editor_out(ed, seq, snprintf(seq, sizeof(seq), "\x1b[%dD", -n));
+    } else {
+        __line_editor_out(ed, seq, snprintf(seq, sizeof(seq), "\x1b[%dC", n));
+    }
+
+    ed->shown_pos = to;
+}
+
+/**
+ * Bring the terminal up to date with the buffer: only the cells from the first difference onwards are redrawn.
+ */
+void __line_editor_refresh(line_editor *ed) {
+    int same = 0;
+
+    while (same < ed->len && same < ed->shown_len && ed->buf[same] == ed->shown[same]) {
+        same++;
+    }
+
+    if (same < ed->len || same < ed->shown_len) {
+        __line_editor_move(ed, same);
+        __line_editor_out(ed, ed->buf + same, ed->len - same);
+
+        if (ed->shown_len > ed->len) {
+            /** erase to the end of the line */
+            __line_editor_out(ed, "\x1b[K", 3);
+        }
+
+        if (__line_editor_grow(&ed->shown, &ed->shown_size, ed->len) == 0) {
+            memcpy(ed->shown, ed->buf, ed->len);
+            ed->shown_len = ed->len;
+        }
+
+        ed->shown_pos = ed->len;
+    }
+
+    __line_editor_move(ed, ed->pos);
+    __line_editor_flush(ed);
+}
+
+void __line_editor_insert(line_editor *ed, const char *str, int len) {
+    if (__line_editor_grow(&ed->buf, &ed->size, ed->len + len) != 0) {
+        return;
+    }
+
+    memmove(ed->buf + ed->pos + len, ed->buf + ed->pos, ed->len - ed->pos);
+    memcpy(ed->buf + ed->pos, str, len);
+
+    ed->len += len;
+    ed->pos += len;
+}
+
+/**
+ * Remove the text between from & to, and remember it for yanking back if kill is set.
+ */
+void __line_editor_delete(line_editor *ed, int from, int to, int kill) {
+    if (from >= to) {
+        return;
+    }
+
+    if (kill) {
+        free(yank_buf);
+        yank_buf = strndup(ed->buf + from, to - from);
+    }
+
+    memmove(ed->buf + from, ed->buf + to, ed->len - to);
+
+    ed->len -= to - from;
+    ed->pos = from;
+}
+
+/**
+ * Replace the whole line, leaving the cursor at its end.
+ */
+void __line_editor_set(line_editor *ed, const char *str) {
+    ed->len = 0;
+    ed->pos = 0;
+
+    __line_editor_insert(ed, str, strlen(str));
+}
+
+int __line_editor_word_start(line_editor *ed) {
+    int i = ed->pos;
+
+    while (i > 0 && isspace(ed->buf[i - 1])) {
+        i--;
+    }
+
+    while (i > 0 && !isspace(ed->buf[i - 1])) {
+        i--;
+    }
+
+    return i;
+}
+
+int __line_editor_word_end(line_editor *ed) {
+    int i = ed->pos;
+
+    while (i < ed->len && isspace(ed->buf[i])) {
+        i++;
+    }
+
+    while (i < ed->len && !isspace(ed->buf[i])) {
+        i++;
+    }
+
+    return i;
+}
+
+/**
+ * Step through the history ring; dir is 1 for an older entry, -1 for a newer one.
+ */
+void __line_editor_history(line_editor *ed, int dir) {
+    int count = internal_command_history_count();
+    int next = ed->history_index + dir;
+
+    if (next < 0 || next > count) {
+        return;
+    }
+
+    if (ed->history_index == 0) {
+        free(ed->scratch);
+        ed->scratch = strndup(ed->buf != NULL ? ed->buf : "", ed->len);
+    }
+
+    ed->history_index = next;
+
+    if (next == 0) {
+        __line_editor_set(ed, ed->scratch);
+    } else {
+        __line_editor_set(ed, internal_command_history_command(count - next));
+    }
+}
+
+/**
+ * Clear the screen, then draw the prompt & line again from scratch.
+ */
+void __line_editor_clear_screen(line_editor *ed, char *prompt) {
+    char *rendered = prompt_render(prompt);
+
+    __line_editor_out(ed, "\x1b[H\x1b[2J", 7);
+    __line_editor_out(ed, rendered, strlen(rendered));
+
+    ed->shown_len = 0;
+    ed->shown_pos = 0;
+}
+
+/**
+ * Print the completion choices in columns below the line, then draw the prompt & line again.
+ */
+void __line_editor_list(line_editor *ed, completion *comp, char *prompt) {
+    struct winsize ws;
+    int width = 80;
+    int column = 0;
+    int longest = 0;
+    int shown = comp->count < LINE_EDITOR_LIST_MAX ? comp->count : LINE_EDITOR_LIST_MAX;
+    char *rendered = NULL;
+    char more[64];
+
+    if (ioctl(fileno(stdout), TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0) {
+        width = ws.ws_col;
+    }
+
+    for (int i = 0; i < shown; i++) {
+        int len = strlen(comp->matches[i].name);
+        longest = len > longest ? len : longest;
+    }
+
+    __line_editor_move(ed, ed->shown_len);
+    __line_editor_out(ed, "\n", 1);
+
+    for (int i = 0; i < shown; i++) {
+        int len = strlen(comp->matches[i].name);
+
+        if (column > 0 && column + longest + 2 > width) {
+            __line_editor_out(ed, "\n", 1);
+            column = 0;
+        }
+
+        __line_editor_out(ed, comp->matches[i].name, len);
+
+        for (column += len; column % (longest + 2) != 0; column++) {
+            __line_editor_out(ed, " ", 1);
+        }
+    }
+
+    __line_editor_out(ed, "\n", 1);
+
+    if (comp->count > shown) {
+        __line_editor_out(ed, more, snprintf(more, sizeof(more), "(%d more)\n", comp->count - shown));
+    }
+
+    rendered = prompt_render(prompt);
+    __line_editor_out(ed, rendered, strlen(rendered));
+
+    ed->shown_len = 0;
+    ed->shown_pos = 0;
+}
+
+/**
+ * Complete the word before the cursor as far as all of its choices agree.
+ * When there's nothing more to add, a second tab in a row lists the choices.
+ */
+void __line_editor_complete(line_editor *ed, char *prompt, int again) {
+    completion comp;
+    int typed;
+    int common;
+
+    if (completion_find(ed->buf != NULL ? ed->buf : "", ed->len, ed->pos, &comp) != 0 || comp.count == 0) {
+        completion_free(&comp);
+        __line_editor_out(ed, "\a", 1);
+        return;
+    }
+
+    typed = ed->pos - comp.base;
+    common = strlen(comp.matches[0].name);
+
+    for (int i = 1; i < comp.count; i++) {
+        int j = typed;
+
+        while (j < common && comp.matches[i].name[j] == comp.matches[0].name[j]) {
+            j++;
+        }
+
+        common = j;
+    }
+
+    if (common > typed) {
+        __line_editor_insert(ed, comp.matches[0].name + typed, common - typed);
+    }
+
+    if (comp.count == 1) {
+        __line_editor_insert(ed, !comp.command && comp.matches[0].type == DT_DIR ? "/" : " ", 1);
+    } else if (common == typed && again) {
+        __line_editor_list(ed, &comp, prompt);
+    }
+
+    completion_free(&comp);
+}
+
+/**
+ * Read the rest of an escape sequence & turn it into the control key that does the same thing.
+ *
+ * @returns
+ * the equivalent key, or 0 if the sequence isn't bound.
+ */
+int __line_editor_escape(line_editor *ed) {
+    char seq[3];
+
+    if (read(ed->fd, &seq[0], 1) != 1) {
+        return 0;
+    }
+
+    if (seq[0] == 'b') {
+        return 'b' | 0x100;
+    } else if (seq[0] == 'f') {
+        return 'f' | 0x100;
+    } else if (seq[0] != '[' && seq[0] != 'O') {
+        return 0;
+    }
+
+    if (read(ed->fd, &seq[1], 1) != 1) {
+        return 0;
+    }
+
+    if (seq[1] >= '0' && seq[1] <= '9') {
+        /** e.g.) ESC [ 3 ~ */
+        if (read(ed->fd, &seq[2], 1) != 1 || seq[2] != '~') {
+            return 0;
+        }
+
+        switch (seq[1]) {
+            case '1':
+            case '7':
+                return CTRL_KEY('a');
+            case '4':
+            case '8':
+                return CTRL_KEY('e');
+            case '3':
+                return KEY_ESC | 0x100;
+        }
+
+        return 0;
+    }
+
+    switch (seq[1]) {
+        case 'A':
+            return CTRL_KEY('p');
+        case 'B':
+            return CTRL_KEY('n');
+        case 'C':
+            return CTRL_KEY('f');
+        case 'D':
+            return CTRL_KEY('b');
+        case 'H':
+            return CTRL_KEY('a');
+        case 'F':
+            return CTRL_KEY('e');
+    }
+
+    return 0;
+}
+
+void __line_editor_free(line_editor *ed) {
+    free(ed->buf);
+    free(ed->shown);
+    free(ed->scratch);
+    free(ed->out);
+}
+
+/**
+ * Read a line from a terminal, with editing & history recall.
+ * Falls back to readline() when fd isn't a terminal.
+ *
+ * @returns
+ * the line, which the caller must free, or NULL at the end of input.
+ */
+char *line_editor_readline(char *prompt, int fd) {
+    line_editor ed = {0};
+    char *line = NULL;
+    int done = 0;
+    int last_key = 0;
+    long long trace_start;
+    char c;
+
+    if (!isatty(fd) || __line_editor_raw_enable(fd) != 0) {
+        return readline(prompt, fd);
+    }
+
+    ed.fd = fd;
+
+    if (prompt != NULL) {
+        fputs(prompt_render(prompt), stdout);
+    }
+
+    fflush(stdout);
+
+    trace_start = trace_begin();
+
+    while (!done) {
+        int key;
+
+        if (readline_wait(fd) < 0 || read(fd, &c, 1) != 1) {
+            break;
+        }
+
+        key = (unsigned char)c;
+
+        if (key == KEY_ESC) {
+            key = __line_editor_escape(&ed);
+        }
+
+        switch (key) {
+            case '\r':
+            case '\n':
+                ed.pos = ed.len;
+                done = 1;
+                break;
+            case CTRL_KEY('c'):
+                __line_editor_out(&ed, "^C", 2);
+                ed.len = 0;
+                ed.pos = 0;
+                ed.shown_len = 0;
+                ed.shown_pos = 0;
+                done = 1;
+                break;
+            case CTRL_KEY('d'):
+                if (ed.len == 0) {
+                    __line_editor_out(&ed, "\n", 1);
+                    __line_editor_flush(&ed);
+                    __line_editor_raw_disable();
+                    __line_editor_free(&ed);
+
+                    return NULL;
+                }
+
+                __line_editor_delete(&ed, ed.pos, ed.pos < ed.len ? ed.pos + 1 : ed.pos, 0);
+                break;
+            case KEY_ESC | 0x100:
+                __line_editor_delete(&ed, ed.pos, ed.pos < ed.len ? ed.pos + 1 : ed.pos, 0);
+                break;
+            case KEY_BACKSPACE:
+            case CTRL_KEY('h'):
+                __line_editor_delete(&ed, ed.pos > 0 ? ed.pos - 1 : 0, ed.pos, 0);
+                break;
+            case CTRL_KEY('b'):
+                ed.pos = ed.pos > 0 ? ed.pos - 1 : 0;
+                break;
+            case CTRL_KEY('f'):
+                ed.pos = ed.pos < ed.len ? ed.pos + 1 : ed.len;
+                break;
+            case 'b' | 0x100:
+                ed.pos = __line_editor_word_start(&ed);
+                break;
+            case 'f' | 0x100:
+                ed.pos = __line_editor_word_end(&ed);
+                break;
+            case CTRL_KEY('a'):
+                ed.pos = 0;
+                break;
+            case CTRL_KEY('e'):
+                ed.pos = ed.len;
+                break;
+            case CTRL_KEY('k'):
+                __line_editor_delete(&ed, ed.pos, ed.len, 1);
+                break;
+            case CTRL_KEY('u'):
+                __line_editor_delete(&ed, 0, ed.pos, 1);
+                break;
+            case CTRL_KEY('w'):
+                __line_editor_delete(&ed, __line_editor_word_start(&ed), ed.pos, 1);
+                break;
+            case CTRL_KEY('y'):
+                if (yank_buf != NULL) {
+                    __line_editor_insert(&ed, yank_buf, strlen(yank_buf));
+                }
+                break;
+            case CTRL_KEY('p'):
+                __line_editor_history(&ed, 1);
+                break;
+            case CTRL_KEY('n'):
+                __line_editor_history(&ed, -1);
+                break;
+            case '\t':
+                __line_editor_complete(&ed, prompt, last_key == '\t');
+                break;
+            case CTRL_KEY('l'):
+                __line_editor_clear_screen(&ed, prompt);
+                break;
+            default:
+                if (key >= ' ' && key < KEY_BACKSPACE) {
+                    __line_editor_insert(&ed, &c, 1);
+                }
+                break;
+        }
+
+        __line_editor_refresh(&ed);
+        last_key = key;
+    }
+
+    __line_editor_out(&ed, "\n", 1);
+    __line_editor_flush(&ed);
+    __line_editor_raw_disable();
+
+    if (done) {
+        line = strndup(ed.buf != NULL ? ed.buf : "", ed.len);
+    } else if (ed.len > 0) {
+        /** input ended part way through a line */
+        line = strndup(ed.buf, ed.len);
+    }
+
+    __line_editor_free(&ed);
+
+    trace_end(TRACE_READLINE, NULL, trace_start);
+
+    return line;
+}
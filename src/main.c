@@ -11,15 +11,24 @@
 #include "globals.h"
 #include "interactive_mode.h"
 #include "io.h"
+#include "metrics.h"
 #include "parse_command.h"
 #include "parse_path.h"
+#include "reaper.h"
 #include "readline.h"
-#include "signals.h"
+#include "session.h"
 #include "string_list.h"
+#include "trace.h"
 
 int main(int argc, char *argv[], char *envp[]) {
     /** Determine whether batchmode was initialized. */
     char *filename = NULL;
+    char *command_string = NULL;
+    int read_stdin = 0;
+    int first_param = argc;
+    char *record_path = NULL;
+    char *replay_path = NULL;
+    int paced = 0;
     int d = -1;
 
     for (int i = 1; i < argc; i++) {
@@ -37,6 +46,63 @@ int main(int argc, char *argv[], char *envp[]) {
             continue;
         }
 
+        if (strcmp(argv[i], METRICS_FLAG) == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "smash: error - %s needs a file to write to\n", METRICS_FLAG);
+                return 1;
+            }
+
+            if (metrics_open(argv[++i]) != 0) {
+                fprintf(stderr, "smash: error - unable to open metrics file '%s'\n", argv[i]);
+                return 1;
+            }
+
+            continue;
+        }
+
+        if (strcmp(argv[i], RECORD_FLAG) == 0 || strcmp(argv[i], REPLAY_FLAG) == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "smash: error - %s needs a session file\n", argv[i]);
+                return 1;
+            }
+
+            if (strcmp(argv[i], RECORD_FLAG) == 0) {
+                record_path = argv[++i];
+            } else {
+                replay_path = argv[++i];
+            }
+
+            continue;
+        }
+
+        /** $ smash -c 'commands' [args...] & $ smash -s [args...] - any args left over are $1..$N */
+        if (strcmp(argv[i], COMMAND_STRING_FLAG) == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "smash: error - %s needs a string of commands\n", COMMAND_STRING_FLAG);
+                return 1;
+            }
+
+            command_string = argv[++i];
+            first_param = i + 1;
+            break;
+        }
+
+        if (strcmp(argv[i], STDIN_FLAG) == 0) {
+            read_stdin = 1;
+            first_param = i + 1;
+            break;
+        }
+
+        if (strcmp(argv[i], PACE_FLAG) == 0) {
+            paced = 1;
+            continue;
+        }
+
+        if (strcmp(argv[i], MEM_STATS_FLAG) == 0) {
+            executor_enable_mem_stats();
+            continue;
+        }
+
         if (strcmp(argv[i], "-v") == 0) {
             fprintf(stdout, "version: %s\n", SMASH_VERSION);
             return 0;
@@ -63,13 +129,40 @@ int main(int argc, char *argv[], char *envp[]) {
         }
     }
 
+    /**
+     * SMASH_TRACE=file.json writes a timeline of everything run, for chrome://tracing or Perfetto.
+     * Read before the environment is parsed (which splits its strings in place).
+     */
+    char *trace_path = NULL;
+
+    if ((trace_path = getenv(ENV_TRACE_KEY)) != NULL && trace_path[0] != NULL_CHAR && trace_open(trace_path) != 0) {
+        fprintf(stderr, "smash: error - unable to open trace file '%s'\n", trace_path);
+        return 1;
+    }
+
+    /**
+     * A replayed session starts out where the recorded one did: in its working directory, with its environment.
+     */
+    session_replay *replay = NULL;
+
+    if (replay_path != NULL) {
+        if ((replay = session_replay_open(replay_path, paced)) == NULL) {
+            fprintf(stderr, "smash: error - unable to read recorded session '%s'\n", replay_path);
+            return 1;
+        }
+
+        if (replay->cwd != NULL && chdir(replay->cwd) != 0) {
+            fprintf(stderr, "smash: warning - unable to change directory to '%s'\n", replay->cwd);
+        }
+
+        envp = replay->env;
+    }
+
     /**
      * Parses out all the environment variables for later ease of retrieval using parse_path_get_env()
      */
     char *path_string = NULL;
-    char **env_list = NULL;
-
-    if ((env_list = parse_path_all_env_params(envp)) == NULL) {
+    if (parse_path_all_env_params(envp) != 0) {
         fprintf(stderr, "error: unable to parse path of the env variables");
         return 1;
     }
@@ -89,6 +182,9 @@ int main(int argc, char *argv[], char *envp[]) {
         return 1;
     }
 
+    /** from now on, it's split again whenever $PATH changes */
+    executor_sync_bin_list(bin_list);
+
     /**
      * Initialize the jobs list
      * -> Initializes a list which contains currently running job info.
@@ -101,32 +197,64 @@ int main(int argc, char *argv[], char *envp[]) {
     }
 
     /**
-     * Set sig hook function in readline
+     * Finished jobs are reaped through pidfds in an epoll set,
+     * which readline waits on together with its input.
      */
-    struct sigaction sc;
-    sc.sa_handler = signals_job_done;
-    sc.sa_flags = 0;
+    if (reaper_init() != 0) {
+        fprintf(stderr, "error: unable to initialize the job reaper\n");
+        return 1;
+    }
 
-    sigemptyset(&sc.sa_mask);
+    readline_set_wait_hook(reaper_wait_readable);
 
-    if (sigaction(SIGCHLD, &sc, NULL) == -1) {
-        fprintf(stderr, "error: unable to set SIGCHLD handler for finding finished jobs\n");
+    /** every input line from here on is recorded, whether typed, read from a script or replayed */
+    if (record_path != NULL && session_record_open(record_path) != 0) {
+        fprintf(stderr, "smash: error - unable to open session file '%s'\n", record_path);
         return 1;
     }
 
-    readline_set_sig_hook(signals_readline_operator);
+    if (replay != NULL) {
+        debug("replaying recorded session\n");
+
+        return batch_mode_replay(replay, bin_list);
+    }
+
+    if (first_param < argc) {
+        string_list *params = string_list_from(argv[first_param]);
+
+        for (int i = first_param + 1; params != NULL && i < argc; i++) {
+            string_list_push(params, argv[i]);
+        }
+
+        parse_path_set_positional(params);
+    }
+
+    if (command_string != NULL) {
+        debug("running the command string\n");
+
+        return batch_mode_run_string(command_string, bin_list);
+    }
+
+    /**
+     * Input that isn't from a terminal (e.g. a pipe) is a script, run just like a file would be.
+     */
+    if (filename == NULL && (read_stdin == 1 || !isatty(fileno(stdin)))) {
+        debug("batch mode enabled, reading stdin\n");
+
+        return batch_mode_run_fd(fileno(stdin), bin_list);
+    }
 
     /**
      * Run interactive mode if no file was given as arg.
      */
     if (filename == NULL) {
         debug("interactive mode enabled\n");
-        pointer_pointer_debug(env_list, -1);
+        pointer_pointer_debug(parse_path_envp(), -1);
 
-        return interactive_mode_run(argc, argv, bin_list, env_list);
+        return interactive_mode_run(argc, argv, bin_list);
     }
 
     debug("batch (non-interactive) mode enabled\n");
 
-    return batch_mode_run(filename, bin_list, env_list);
+    return batch_mode_run(filename, bin_list);
 }
@@ -0,0 +1,197 @@
+#include "metrics.h"
+
+static int metrics_fd = -1;
+static int metrics_csv = 0;
+
+/** only the shell itself writes the buffer out; forked children have a copy of it */
+static pid_t metrics_owner = -1;
+
+static char metrics_buffer[METRICS_BUFFER_SIZE];
+static int metrics_used = 0;
+
+static const char *METRICS_CSV_HEADER =
+    "pid,started,command,kind,exit,parse_ns,lookup_ns,spawn_ns,wall_ns,utime_us,stime_us,maxrss_kb,minflt,majflt,nvcsw,nivcsw\n";
+
+/**
+ * Write out whatever is buffered.
+ */
+void metrics_flush(void) {
+    int written = 0;
+
+    if (metrics_fd == -1 || getpid() != metrics_owner) {
+        return;
+    }
+
+    while (written < metrics_used) {
+        int ret = write(metrics_fd, metrics_buffer + written, metrics_used - written);
+
+        if (ret <= 0) {
+            debug("error: unable to write metrics: %d\n", ret);
+            break;
+        }
+
+        written += ret;
+    }
+
+    metrics_used = 0;
+}
+
+void __metrics_write(const char *str, int len) {
+    if (metrics_used + len > METRICS_BUFFER_SIZE) {
+        metrics_flush();
+    }
+
+    /** a record bigger than the whole buffer goes straight out */
+    if (len > METRICS_BUFFER_SIZE) {
+        if (write(metrics_fd, str, len) != len) {
+            debug("error: short write of metrics\n");
+        }
+
+        return;
+    }
+
+    memcpy(metrics_buffer + metrics_used, str, len);
+    metrics_used += len;
+}
+
+/**
+ * Write the command as a quoted JSON or CSV string.
+ */
+void __metrics_write_string(char *str) {
+    char escaped[8];
+
+    __metrics_write("\"", 1);
+
+    for (char *c = str; *c != '\0'; c++) {
+        if (metrics_csv) {
+            __metrics_write(c, 1);
+
+            if (*c == '"') {
+                __metrics_write("\"", 1);
+            }
+        } else if (*c == '"' || *c == '\\') {
+            escaped[0] = '\\';
+            escaped[1] = *c;
+            __metrics_write(escaped, 2);
+        } else if ((unsigned char)*c < 0x20) {
+            __metrics_write(escaped, snprintf(escaped, sizeof(escaped), "\\u%04x", *c));
+        } else {
+            __metrics_write(c, 1);
+        }
+    }
+
+    __metrics_write("\"", 1);
+}
+
+/**
+ * Start logging to the file at path, appending to it. A path ending in '.csv' selects CSV.
+ */
+int metrics_open(char *path) {
+    struct stat st;
+    int len = strlen(path);
+
+    if ((metrics_fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644)) == -1) {
+        return -1;
+    }
+
+    metrics_owner = getpid();
+    metrics_csv = len >= 4 && strcmp(path + len - 4, ".csv") == 0;
+
+    if (metrics_csv && fstat(metrics_fd, &st) == 0 && st.st_size == 0) {
+        __metrics_write(METRICS_CSV_HEADER, strlen(METRICS_CSV_HEADER));
+    }
+
+    atexit(metrics_flush);
+
+    return 0;
+}
+
+/**
+ * Take the log over in a forked subshell, which runs commands of its own: what's buffered is the shell's to write out,
+ * so the subshell starts with an empty buffer, & writes out its own records as it exits.
+ */
+void metrics_reinit(void) {
+    metrics_owner = getpid();
+    metrics_used = 0;
+}
+
+int metrics_enabled(void) {
+    return metrics_fd != -1;
+}
+
+/**
+ * Monotonic time, in nanoseconds.
+ */
+long long metrics_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * Begin timing a command. Does nothing when metrics are off.
+ */
+void metrics_start(metrics_timing *timing, char *command) {
+    memset(timing, 0, sizeof(metrics_timing));
+
+    if (metrics_fd == -1) {
+        return;
+    }
+
+    timing->command = command;
+    clock_gettime(CLOCK_REALTIME, &timing->started);
+    timing->start_ns = metrics_now();
+}
+
+/**
+ * Add the record of a command that has finished. usage is the rusage of a reaped job, or NULL for builtins.
+ * Frees the timing's command.
+ */
+void metrics_record(metrics_timing *timing, int exit_code, struct rusage *usage) {
+    struct rusage none;
+    char fields[512];
+    int len;
+
+    if (metrics_fd == -1 || timing->command == NULL) {
+        return;
+    }
+
+    if (usage == NULL) {
+        memset(&none, 0, sizeof(none));
+        usage = &none;
+    }
+
+    long long wall_ns = metrics_now() - timing->start_ns;
+    long utime_us = usage->ru_utime.tv_sec * 1000000L + usage->ru_utime.tv_usec;
+    long stime_us = usage->ru_stime.tv_sec * 1000000L + usage->ru_stime.tv_usec;
+
+    if (metrics_csv) {
+        len = snprintf(fields, sizeof(fields), "%d,%ld.%06ld,", getpid(), (long)timing->started.tv_sec,
+                       timing->started.tv_nsec / 1000);
+        __metrics_write(fields, len);
+        __metrics_write_string(timing->command);
+
+        len = snprintf(fields, sizeof(fields), ",%s,%d,%lld,%lld,%lld,%lld,%ld,%ld,%ld,%ld,%ld,%ld,%ld\n",
+                       timing->kind, exit_code, timing->parse_ns, timing->lookup_ns, timing->spawn_ns, wall_ns, utime_us,
+                       stime_us, usage->ru_maxrss, usage->ru_minflt, usage->ru_majflt, usage->ru_nvcsw, usage->ru_nivcsw);
+    } else {
+        len = snprintf(fields, sizeof(fields), "{\"pid\":%d,\"started\":%ld.%06ld,\"command\":", getpid(),
+                       (long)timing->started.tv_sec, timing->started.tv_nsec / 1000);
+        __metrics_write(fields, len);
+        __metrics_write_string(timing->command);
+
+        len = snprintf(fields, sizeof(fields),
+                       ",\"kind\":\"%s\",\"exit\":%d,\"parse_ns\":%lld,\"lookup_ns\":%lld,\"spawn_ns\":%lld,\"wall_ns\":%lld,"
+                       "\"utime_us\":%ld,\"stime_us\":%ld,\"maxrss_kb\":%ld,\"minflt\":%ld,\"majflt\":%ld,\"nvcsw\":%ld,"
+                       "\"nivcsw\":%ld}\n",
+                       timing->kind, exit_code, timing->parse_ns, timing->lookup_ns, timing->spawn_ns, wall_ns, utime_us,
+                       stime_us, usage->ru_maxrss, usage->ru_minflt, usage->ru_majflt, usage->ru_nvcsw, usage->ru_nivcsw);
+    }
+
+    __metrics_write(fields, len);
+
+    free(timing->command);
+    timing->command = NULL;
+}
@@ -1,11 +1,18 @@
 #include "parse_command.h"
 
 string_list *parse_command_to_string_list(char *command) {
+    string_list *tokens = NULL;
+    long long trace_start = trace_begin();
+
     if (command == NULL) {
         return NULL;
     }
 
-    return string_list_from_delim(command, " ");
+    tokens = string_list_from_delim(command, " ");
+
+    trace_end(TRACE_LEX, NULL, trace_start);
+
+    return tokens;
 }
 
 /**
@@ -38,7 +45,7 @@ char *__get_output_redirect(string_list *command) {
         if (strstr(command->strings[i], OUTPUT_REDIRECT_KEY) != NULL && strstr(command->strings[i], OUTPUT_ERROR_REDIRECT_KEY) == NULL) {
             debug("found output redirect key\n");
 
-            if (strcmp(strstr(command->strings[i], OUTPUT_REDIRECT_KEY) + 1, "") == 0 || (strstr(command->strings[i], OUTPUT_REDIRECT_KEY) + 1) == NULL) {
+            if (strcmp(strstr(command->strings[i], OUTPUT_REDIRECT_KEY) + 1, "") == 0) {
                 // the char after the > is empty string/null so the output file is probably the next string list value: `> out.txt`
                 if (i + 1 < command->size) {
                     return command->strings[i + 1];
@@ -65,7 +72,7 @@ char *__get_output_error_redirect(string_list *command) {
         if (strstr(command->strings[i], OUTPUT_ERROR_REDIRECT_KEY) != NULL) {
             debug("found output redirect key\n");
 
-            if (strcmp(strstr(command->strings[i], OUTPUT_ERROR_REDIRECT_KEY) + 2, "") == 0 || (strstr(command->strings[i], OUTPUT_ERROR_REDIRECT_KEY) + 2) == NULL) {
+            if (strcmp(strstr(command->strings[i], OUTPUT_ERROR_REDIRECT_KEY) + 2, "") == 0) {
                 if (i + 1 < command->size) {
                     return command->strings[i + 1];
                 }
@@ -90,7 +97,7 @@ char *__get_input_redirect(string_list *command) {
         if (strstr(command->strings[i], INPUT_REDIRECT_KEY) != NULL) {
             debug("found input redirect key\n");
 
-            if (strcmp(strstr(command->strings[i], INPUT_REDIRECT_KEY) + 1, "") == 0 || (strstr(command->strings[i], INPUT_REDIRECT_KEY) + 1) == NULL) {
+            if (strcmp(strstr(command->strings[i], INPUT_REDIRECT_KEY) + 1, "") == 0) {
                 if (i + 1 < command->size) {
                     return command->strings[i + 1];
                 }
@@ -113,91 +120,65 @@ char *__get_binary_name(string_list *command) {
     return strdup(command->strings[0]);
 }
 
-typedef struct bin_param {
-    int num;
-    char **params;
-    int exited;
-} bin_param;
-
 /**
  * Get the command's parameters - basically don't include the binary name (first param)
- * and ignore input and output redirection params and the '&' bg key
+ * and ignore input and output redirection params and the '&' bg key.
+ * Variables are replaced by their values, & patterns by the paths they match; they're all stored in the one list.
  */
-bin_param *__get_binary_params(string_list *command) {
-    bin_param *bp = NULL;
-    int i;
+string_list *__get_binary_params(string_list *command) {
+    string_list *params = NULL;
 
-    if ((bp = malloc(sizeof(bin_param))) == NULL) {
-        debug("error: unable to allocate space for bin params bp\n");
+    if ((params = string_list_new()) == NULL) {
+        debug("error: unable to allocate space for bin params\n");
         return NULL;
     }
 
-    bp->num = 0;
-    bp->exited = 0;
-
-    if (command->size == 1) {
-        return bp;
-    }
-
-    /** space to hold at least one parameter */
-    if ((bp->params = malloc(1 * sizeof(char *))) == NULL) {
-        debug("error: unable to malloc space for params\n");
-        return NULL;
-    }
-
-    for (i = 1; i < command->size; i++) {
+    for (int i = 1; i < command->size; i++) {
         if (strstr(command->strings[i], INPUT_REDIRECT_KEY) != NULL || strstr(command->strings[i], OUTPUT_REDIRECT_KEY) != NULL || strcmp(command->strings[i], BACKGROUND_KEY) == 0) {
-            bp->num = i - 1;
-
-            return bp;
+            break;
         }
 
         debug("found a valid parameter of: '%s'\n", command->strings[i]);
 
-        if (i > 1) {
-            if ((bp->params = realloc(bp->params, (1 + i) * sizeof(char *))) == NULL) {
-                debug("error: unable to reallocate space for params\n");
-                return NULL;
-            }
-        }
-
         /**
          * Determine whether the command parameter is actually a variable we need to parse.
          */
         char *real_arg = command->strings[i];
+        char *value = NULL;
+        char last_return[12];
 
         if (command->strings[i][0] == VARIABLE_START_KEY) {
             if (strcmp(real_arg, LAST_RETURN_KEY) == 0) {
+                /** never write into the token itself; parsed scripts re-use their tokens */
                 debug("should replace last return key\n");
-                sprintf(real_arg, "%d", get_last_return_value());
+                sprintf(last_return, "%d", get_last_return_value());
+                real_arg = last_return;
             } else {
                 debug("this parameter: '%s', is a variable\n", real_arg);
                 parse_path_debug_env_variables();
 
-                if ((real_arg = parse_path_get_env(strchr(command->strings[i], VARIABLE_START_KEY) + 1)) == NULL) {
-                    real_arg = command->strings[i];
+                if ((value = parse_path_get_env(strchr(command->strings[i], VARIABLE_START_KEY) + 1)) != NULL) {
+                    real_arg = value;
                 }
 
                 debug("this variable: '%s', is now a value\n", real_arg);
             }
         }
 
-        if ((bp->params[i - 1] = malloc(strlen(real_arg) + 1)) == NULL) {
-            debug("error: unable to allocate space for bp params indices\n");
-            return NULL;
+        /** a pattern that matches nothing is passed through as it is */
+        if (!glob_expand_has_magic(real_arg) || glob_expand(real_arg, params) == 0) {
+            string_list_push(params, real_arg);
         }
 
-        memcpy(bp->params[i - 1], real_arg, strlen(real_arg) + 1);
+        free(value);
     }
 
-    bp->num = i - 1;
-
-    return bp;
+    return params;
 }
 
 commander *parse_command_from_string_list(string_list *command) {
-    bin_param *param = NULL;
     commander *cmd = NULL;
+    long long trace_start = trace_begin();
 
     if (command == NULL) {
         return NULL;
@@ -213,6 +194,14 @@ commander *parse_command_from_string_list(string_list *command) {
     cmd->started = -1;
     cmd->finished = -1;
     cmd->running = -1;
+    cmd->pidfd = -1;
+    cmd->timeout_ns = 0;
+    cmd->kill_after_ns = 0;
+    cmd->timerfd = -1;
+    cmd->timed_out = 0;
+    cmd->output_fd[0] = -1;
+    cmd->output_fd[1] = -1;
+    memset(&cmd->timing, 0, sizeof(metrics_timing));
     cmd->exit_code = -1;  // set it later if finished == 1 set exit code. or get it only when finished == 1 too.
 
     if ((cmd->raw_command = malloc(sizeof(string_list))) == NULL) {
@@ -225,25 +214,74 @@ commander *parse_command_from_string_list(string_list *command) {
     cmd->bin_dir = NULL;  // set in executor
     cmd->bin = __get_binary_name(command);
 
-    if ((param = __get_binary_params(command)) == NULL) {
+    if ((cmd->params = __get_binary_params(command)) == NULL) {
         debug("error: unable to get binary params\n");
         return NULL;
     }
 
-    if (param->num == 0) {
-        cmd->num_bin_params = 0;
-    } else {
-        cmd->bin_params = param->params;
-        cmd->num_bin_params = param->num;
-    }
+    cmd->num_bin_params = cmd->params->size;
+    cmd->bin_params = cmd->num_bin_params > 0 ? cmd->params->strings : NULL;
 
     cmd->output_redirect = __get_output_redirect(command);
     cmd->output_error_redirect = __get_output_error_redirect(command);
     cmd->input_redirect = __get_input_redirect(command);
+    cmd->argv = NULL;  // set in executor
+    cmd->limits = NULL;  // set in executor
+    cmd->trace_start = 0;  // set in executor
+
+    trace_end(TRACE_PARSE, cmd->bin, trace_start);
 
     return cmd;
 }
 
+/**
+ * Find the redirects among the tokens without parsing a whole command, e.g.) those after a group: '} > out 2> err'.
+ * The paths point into the tokens.
+ */
+void parse_command_redirects(string_list *tokens, char **input_redirect, char **output_redirect, char **output_error_redirect) {
+    *input_redirect = __get_input_redirect(tokens);
+    *output_redirect = __get_output_redirect(tokens);
+    *output_error_redirect = __get_output_error_redirect(tokens);
+}
+
+/**
+ * Free the commander & everything it owns. Its redirects & raw_command's strings belong to the tokens it was parsed from.
+ */
+void parse_command_free(commander *cmd) {
+    if (cmd == NULL) {
+        return;
+    }
+
+    string_list_free(cmd->params);
+    free(cmd->argv);
+    free(cmd->bin);
+    free(cmd->raw_command);
+    free(cmd->limits);
+    free(cmd->timing.command);
+    free(cmd);
+}
+
+/**
+ * @returns the bytes allocated for the commander & everything it owns
+ */
+size_t parse_command_size(commander *cmd) {
+    size_t size = sizeof(commander) + sizeof(string_list) + strlen(cmd->bin) + 1;
+
+    if (cmd->params != NULL) {
+        size += sizeof(string_list) + cmd->params->capacity * (sizeof(char *) + sizeof(size_t)) + cmd->params->chars_capacity;
+    }
+
+    if (cmd->limits != NULL) {
+        size += sizeof(job_limits);
+    }
+
+    if (cmd->timing.command != NULL) {
+        size += strlen(cmd->timing.command) + 1;
+    }
+
+    return size;
+}
+
 void parse_command_debug_commander(commander *cmd) {
     if (cmd == NULL) {
         debug("commander was null.\n");
@@ -2,6 +2,24 @@
 
 static int LAST_RETURN = 0;
 
+/** $1..$N of the function currently running, or NULL outside of a function */
+static string_list *positional_params;
+
+static const char *POSITIONAL_COUNT_KEY = "#";
+
+/**
+ * The one store of variables, both the shell's own & those exported to commands. NULL delimited.
+ * The environment handed to commands is built from it only when an exported variable has changed.
+ */
+static env_params **env_variables;
+static int env_count;
+
+static char **env_cache;  // the last environment built by parse_path_envp()
+static int env_dirty;     // 1 if env_cache is out of date
+
+/** 'KEY=value' prefixes of the command being run, or NULL */
+static string_list *env_overrides;
+
 int get_last_return_value() {
     return LAST_RETURN;
 }
@@ -11,85 +29,118 @@ void set_last_return_value(int code) {
 }
 
 /**
- * Parse out all the environment variables, and set it in the static variable @see env_params
+ * Find a variable's index in the store.
+ * @returns -1 if it isn't set
  */
-char **parse_path_all_env_params(char *envp[]) {
-    int i = 0;
-    char *token = NULL;
-    char **env_list = NULL;
-    char *path_value = NULL;
+int __env_find(char *key) {
+    for (int i = 0; i < env_count; i++) {
+        if (strcmp(env_variables[i]->key, key) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Get a variable's entry in the store, adding an unset one if it doesn't exist yet.
+ */
+env_params *__env_entry(char *key) {
+    env_params *entry = NULL;
+    int i;
+
+    if ((i = __env_find(key)) != -1) {
+        return env_variables[i];
+    }
 
-    if ((env_list = pointer_pointer_dup(envp)) == NULL) {
-        debug("error: unable to get env_list via pointer dup\n");
+    if ((env_variables = realloc(env_variables, (env_count + 2) * sizeof(env_params *))) == NULL) {
+        debug("error: unable to reallocate space for env_variables\n");
         return NULL;
     }
 
-    pointer_pointer_debug(env_list, -1);
+    if ((entry = malloc(sizeof(env_params))) == NULL || (entry->key = strdup(key)) == NULL) {
+        debug("error: unable to allocate space for env_variables indices\n");
+        return NULL;
+    }
 
-    while (envp[i] != NULL) {
-        token = strtok(envp[i], ENV_DELIM);
+    entry->value = NULL;
+    entry->exported = 0;
 
-        /**
-         * Token is only null if no = is found.
-         * No = is found when no valid key-value env variable set.
-         */
-        if (token == NULL) {
-            break;
-        }
+    env_variables[env_count++] = entry;
+    env_variables[env_count] = NULL;
 
-        /**
-         * Resize env_variables to hold 1 more k-v pair pointer
-         */
-        if ((env_variables = realloc(env_variables, (i + 1) * sizeof(env_params **))) == NULL) {
-            debug("error: unable to reallocate space for env_variables\n");
-            return NULL;
-        }
+    return entry;
+}
 
-        if ((env_variables[i] = malloc(1 * sizeof(env_params *))) == NULL) {
-            debug("error: unable to malloc space for env_variables indices\n");
-            return NULL;
-        }
+/**
+ * Replace a variable's value; a NULL value leaves it unset.
+ */
+int __env_assign(env_params *entry, char *value) {
+    char *new_value = NULL;
 
-        /**
-         * Create space for the key and copy it over.
-         */
-        if ((env_variables[i]->key = malloc(strlen(token) + 1)) == NULL) {
-            debug("error: unable to allocate space for env_variables indices key\n");
-            return NULL;
-        }
+    if (value != NULL && (new_value = strdup(value)) == NULL) {
+        debug("error: unable to allocate space for env variable value\n");
+        return -1;
+    }
 
-        memcpy(env_variables[i]->key, token, strlen(token));
-        env_variables[i]->key[strlen(token)] = NULL_CHAR;
+    free(entry->value);
+    entry->value = new_value;
 
-        /**
-         * Create space for the value and copy it over
-         */
-        path_value = strtok(NULL, ENV_DELIM);
+    if (entry->exported) {
+        env_dirty = 1;
+    }
 
-        if ((env_variables[i]->value = malloc(strlen(path_value) + 1)) == NULL) {
-            debug("error: unable to allocate space for env_variables indices value\n");
-            return NULL;
-        }
+    return 0;
+}
 
-        memcpy(env_variables[i]->value, path_value, strlen(path_value));
-        env_variables[i]->value[strlen(path_value)] = NULL_CHAR;
+/**
+ * The value a command's 'KEY=value' prefix gives the variable named key.
+ * @returns NULL if there's no such prefix
+ */
+char *__env_override(char *key) {
+    for (int i = 0; env_overrides != NULL && i < env_overrides->size; i++) {
+        char *delim = strchr(env_overrides->strings[i], ENV_DELIM[0]);
+        int key_len = delim - env_overrides->strings[i];
 
-        i++;
+        if (strncmp(env_overrides->strings[i], key, key_len) == 0 && key[key_len] == NULL_CHAR) {
+            return delim + 1;
+        }
     }
 
-    if ((env_variables = realloc(env_variables, i * sizeof(env_params **))) == NULL) {
-        debug("error: unable to reallocate space for env_variables ooc\n");
-        return NULL;
-    }
+    return NULL;
+}
 
-    if ((env_variables[i - 1] = malloc(sizeof(NULL))) == NULL) {
-        debug("error: unable to allocate space for env_variables indices ooc\n");
-        return NULL;
+/**
+ * Parse out all the environment variables into the variable store, each one exported.
+ * envp itself is left untouched.
+ *
+ * @returns 0, or -1 on error
+ */
+int parse_path_all_env_params(char *envp[]) {
+    for (int i = 0; envp[i] != NULL; i++) {
+        char *delim = strchr(envp[i], ENV_DELIM[0]);
+        env_params *entry = NULL;
+
+        /** no '=' means it isn't a valid key-value env variable */
+        if (delim == NULL) {
+            continue;
+        }
+
+        *delim = NULL_CHAR;
+        entry = __env_entry(envp[i]);
+        *delim = ENV_DELIM[0];
+
+        /** the value is everything after the first '=', and may itself be empty or contain '=' */
+        if (entry == NULL || __env_assign(entry, delim + 1) != 0) {
+            return -1;
+        }
+
+        entry->exported = 1;
     }
 
-    env_variables[i - 1] = NULL;
+    env_dirty = 1;
 
-    return env_list;
+    return 0;
 }
 
 /**
@@ -97,20 +148,213 @@ char **parse_path_all_env_params(char *envp[]) {
  * Or return NULL if key not found in env.
  */
 char *parse_path_get_env(char *key) {
+    char *override = NULL;
     int i = 0;
 
-    while (env_variables[i] != NULL) {
-        if (strcmp(env_variables[i]->key, key) == 0) {
-            debug("found env variable for specified key.\n");
-            return strdup(env_variables[i]->value);
+    if (positional_params != NULL) {
+        char *position_end = NULL;
+        long position = strtol(key, &position_end, 10);
+        char count[12];
+
+        if (position > 0 && *position_end == NULL_CHAR) {
+            debug("found positional parameter: %ld\n", position);
+            return strdup(position <= positional_params->size ? positional_params->strings[position - 1] : "");
         }
 
-        i++;
+        if (strcmp(key, POSITIONAL_COUNT_KEY) == 0) {
+            sprintf(count, "%d", positional_params->size);
+            return strdup(count);
+        }
+    }
+
+    /** a command's 'KEY=value' prefixes hide the store while it runs */
+    if ((override = __env_override(key)) != NULL) {
+        return strdup(override);
+    }
+
+    if ((i = __env_find(key)) != -1 && env_variables[i]->value != NULL) {
+        debug("found env variable for specified key.\n");
+        return strdup(env_variables[i]->value);
     }
 
     return NULL;
 }
 
+/**
+ * Set a shell variable, replacing its value if the key already exists.
+ * Used by constructs such as `for x in ...` & `KEY=value` that bind variables at run time.
+ * It's only passed on to commands if it's been exported.
+ */
+int parse_path_set_env(char *key, char *value) {
+    env_params *entry = NULL;
+
+    if ((entry = __env_entry(key)) == NULL) {
+        return -1;
+    }
+
+    return __env_assign(entry, value);
+}
+
+/**
+ * $ export KEY[=value] - pass the variable on to every command run from now on.
+ * With a NULL value, the variable keeps its current value (or stays unset until it's given one).
+ */
+int parse_path_export_env(char *key, char *value) {
+    env_params *entry = NULL;
+
+    if ((entry = __env_entry(key)) == NULL) {
+        return -1;
+    }
+
+    if (!entry->exported) {
+        entry->exported = 1;
+        env_dirty = 1;
+    }
+
+    return value == NULL ? 0 : __env_assign(entry, value);
+}
+
+/**
+ * $ unset KEY - remove the variable from the store.
+ */
+void parse_path_unset_env(char *key) {
+    int i;
+
+    if ((i = __env_find(key)) == -1) {
+        return;
+    }
+
+    if (env_variables[i]->exported) {
+        env_dirty = 1;
+    }
+
+    free(env_variables[i]->key);
+    free(env_variables[i]->value);
+    free(env_variables[i]);
+
+    memmove(env_variables + i, env_variables + i + 1, (env_count - i) * sizeof(env_params *));
+    env_count--;
+}
+
+/**
+ * Hide the store's values behind a command's 'KEY=value' prefixes, or stop hiding them with NULL.
+ * The list isn't copied, & must outlive the command.
+ */
+string_list *parse_path_get_env_overrides(void) {
+    return env_overrides;
+}
+
+void parse_path_set_env_overrides(string_list *assignments) {
+    if (assignments != env_overrides) {
+        env_overrides = assignments;
+        env_dirty = 1;
+    }
+}
+
+/**
+ * Length of the variable name the string starts with: a letter or '_', then letters, digits & '_'s.
+ * e.g.) 3 for 'FOO=bar', & 0 for '1x'
+ */
+int parse_path_name_length(char *string) {
+    char *c = string;
+
+    if (!isalpha(*c) && *c != '_') {
+        return 0;
+    }
+
+    while (isalnum(*c) || *c == '_') {
+        c++;
+    }
+
+    return c - string;
+}
+
+/**
+ * Whether the string is a 'KEY=value' assignment, with a valid variable name for its KEY.
+ */
+int parse_path_is_assignment(char *string) {
+    int len = parse_path_name_length(string);
+
+    return len > 0 && string[len] == ENV_DELIM[0];
+}
+
+/**
+ * The 'KEY=value' environment to execve() commands with: every exported variable that's set, along with any overrides.
+ * Only rebuilt after a change to an exported variable, so spawning with an unchanged environment costs nothing;
+ * a rebuild is a single allocation.
+ */
+char **parse_path_envp(void) {
+    pointer_pointer_block block = {0};
+
+    if (!env_dirty && env_cache != NULL) {
+        return env_cache;
+    }
+
+    /** the entries are sized, then copied into a block of the exact size, in the same order */
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < env_count; i++) {
+            env_params *entry = env_variables[i];
+
+            if (!entry->exported || entry->value == NULL || __env_override(entry->key) != NULL) {
+                continue;
+            }
+
+            if (pass == 0) {
+                pointer_pointer_block_size(&block, entry->key, ENV_DELIM, entry->value);
+            } else {
+                pointer_pointer_block_add(&block, entry->key, ENV_DELIM, entry->value);
+            }
+        }
+
+        for (int i = 0; env_overrides != NULL && i < env_overrides->size; i++) {
+            if (pass == 0) {
+                pointer_pointer_block_size(&block, env_overrides->strings[i], NULL, NULL);
+            } else {
+                pointer_pointer_block_add(&block, env_overrides->strings[i], NULL, NULL);
+            }
+        }
+
+        if (pass == 0) {
+            free(env_cache);
+
+            if ((env_cache = pointer_pointer_block_alloc(&block)) == NULL) {
+                return NULL;
+            }
+        }
+    }
+
+    env_dirty = 0;
+
+    return env_cache;
+}
+
+/**
+ * Print every exported variable, as `export` does with no arguments.
+ */
+void parse_path_print_exported(void) {
+    for (int i = 0; i < env_count; i++) {
+        if (env_variables[i]->exported) {
+            if (env_variables[i]->value != NULL) {
+                fprintf(stdout, "export %s%s%s\n", env_variables[i]->key, ENV_DELIM, env_variables[i]->value);
+            } else {
+                fprintf(stdout, "export %s\n", env_variables[i]->key);
+            }
+        }
+    }
+}
+
+/**
+ * Replace the positional parameters ($1..$N), e.g.) when calling a function.
+ * @returns the previous positional parameters, so that they can be restored once the call returns
+ */
+string_list *parse_path_set_positional(string_list *params) {
+    string_list *previous = positional_params;
+
+    positional_params = params;
+
+    return previous;
+}
+
 /**
  * Split the path variable contents by ':' to retrieve each of its individual directory paths.
  * 
@@ -145,12 +389,29 @@ string_list *parse_path_bin_dirs(char *path_str) {
     return bin_list;
 }
 
+/**
+ * Split the path variable contents into an existing list, in place of the dirs it held, so everything holding the
+ * list sees the new ones. An empty path leaves it with none.
+ */
+void parse_path_bin_dirs_into(string_list *bin_list, char *path_str) {
+    char *token = NULL;
+
+    while (bin_list->size > 0) {
+        string_list_pop(bin_list);
+    }
+
+    for (token = strtok(path_str, BIN_EXEC_DELIM); token != NULL; token = strtok(NULL, BIN_EXEC_DELIM)) {
+        debug("the token is %s\n", token);
+        string_list_push(bin_list, token);
+    }
+}
+
 void parse_path_debug_env_variables() {
     int i = 0;
 
     debug2("attempting to print out all env_variables.\n");
 
-    while (env_variables[i] != NULL) {
+    while (env_variables != NULL && env_variables[i] != NULL) {
         debug2("ENV_VARIABLE - key: '%s'\n", env_variables[i]->key);
         debug2("ENV_VARIABLE - value: '%s'\n", env_variables[i]->value);
         debug2("---- / END PARSE_PATH_DEBUG_ENV_VARIABLES() / ----\n");
@@ -0,0 +1,906 @@
+#include "parse_script.h"
+
+#include "readline.h"
+
+/**
+ * Supported grammar, one statement per line, or several separated by ';' (or '&', which keeps the job in the background):
+ *
+ *   if LIST [; then]          while LIST [; do]          for NAME in [ITEMS...] [; do]
+ *   then                      do                         do
+ *       ...                       ...                        ...
+ *   elif COMMAND [; then]     done                       done
+ *       ...
+ *   else
+ *       ...
+ *   fi
+ *
+ *   NAME() [{]               { ...; } [REDIRECTS]      ( ... ) [REDIRECTS]
+ *   {
+ *       ...
+ *   }
+ *
+ *   LIST:  COMMAND [&& COMMAND] [|| COMMAND] ...
+ *
+ * e.g.) 'for f in a b; do test -f $f || echo missing $f; done' on one line.
+ * Any commands following 'then', 'else' or 'do' begin the body. A step of a list after '&&' only runs if the
+ * one before it succeeded, & after '||' only if it failed; a line ending in either continues on the next.
+ * Any step may be a compound command. A word beginning with '#' starts a comment, to the end of the line.
+ * A '{ }' group runs in the shell itself & a '( )' subshell in a single fork; either may span several lines, & its
+ * redirects apply to every command in it.
+ */
+
+static char *KEYWORD_IF = "if";
+static char *KEYWORD_THEN = "then";
+static char *KEYWORD_ELIF = "elif";
+static char *KEYWORD_ELSE = "else";
+static char *KEYWORD_FI = "fi";
+static char *KEYWORD_WHILE = "while";
+static char *KEYWORD_FOR = "for";
+static char *KEYWORD_IN = "in";
+static char *KEYWORD_DO = "do";
+static char *KEYWORD_DONE = "done";
+static char *KEYWORD_FUNCTION_PARAMS = "()";
+static char *KEYWORD_BRACE_OPEN = "{";
+static char *KEYWORD_BRACE_CLOSE = "}";
+static char *KEYWORD_PAREN_OPEN = "(";
+static char *KEYWORD_PAREN_CLOSE = ")";
+static char *KEYWORD_AND = "&&";
+static char *KEYWORD_OR = "||";
+static const char KEYWORD_SEPARATOR = ';';
+static const char KEYWORD_ESCAPE = '\\';
+static const char COMMENT_KEY = '#';
+
+script_node *__parse_node(script_reader *reader, string_list *tokens);
+
+script_reader *parse_script_reader_new(int fd, char *prompt) {
+    script_reader *reader = NULL;
+
+    if ((reader = malloc(sizeof(script_reader))) == NULL) {
+        debug("error: unable to allocate space for script reader\n");
+        return NULL;
+    }
+
+    reader->fd = fd;
+    reader->prompt = prompt;
+    reader->source = NULL;
+    reader->source_data = NULL;
+    reader->input = NULL;
+
+    /** with no prompt to draw between lines, input can be read in large chunks */
+    if (prompt == NULL && fd != -1 && (reader->input = readline_buffer_new(fd)) == NULL) {
+        free(reader);
+        return NULL;
+    }
+    reader->pending = NULL;
+    reader->line = NULL;
+    reader->line_next = 0;
+    reader->connector = SCRIPT_RUN_ALWAYS;
+    reader->error = 0;
+
+    return reader;
+}
+
+void parse_script_reader_free(script_reader *reader) {
+    if (reader == NULL) {
+        return;
+    }
+
+    string_list_free(reader->pending);
+    string_list_free(reader->line);
+
+    if (reader->input != NULL) {
+        free(reader->input->buf);
+        free(reader->input);
+    }
+
+    free(reader);
+}
+
+/**
+ * Report a syntax error once, and mark the reader as failed.
+ */
+void __syntax_error(script_reader *reader, char *expected) {
+    if (reader->error == 0) {
+        fprintf(stderr, "smash: syntax error: expected '%s'\n", expected);
+    }
+
+    reader->error = 1;
+}
+
+/**
+ * Copy the tokens within [from, to) into a new string list.
+ * @returns NULL if the range is empty
+ */
+string_list *__sub_list(string_list *tokens, int from, int to) {
+    string_list *list = NULL;
+
+    if (from >= to) {
+        return NULL;
+    }
+
+    if ((list = string_list_from(tokens->strings[from])) == NULL) {
+        return NULL;
+    }
+
+    for (int i = from + 1; i < to; i++) {
+        string_list_push(list, tokens->strings[i]);
+    }
+
+    return list;
+}
+
+/**
+ * Read a line from wherever the reader's lines come from.
+ */
+char *__read_line(script_reader *reader) {
+    if (reader->source != NULL) {
+        return reader->source(reader->source_data);
+    }
+
+    if (reader->input != NULL) {
+        return readline_buffered(reader->input);
+    }
+
+    return readline(reader->prompt, reader->fd);
+}
+
+/**
+ * @returns the length of the ';', '&&', '||', '(' or ')' at the start of the string, or 0 if there's none
+ */
+size_t __separator_length(char *at) {
+    if (*at == KEYWORD_SEPARATOR || *at == KEYWORD_PAREN_OPEN[0] || *at == KEYWORD_PAREN_CLOSE[0]) {
+        return 1;
+    }
+
+    if (strncmp(at, KEYWORD_AND, strlen(KEYWORD_AND)) == 0 || strncmp(at, KEYWORD_OR, strlen(KEYWORD_OR)) == 0) {
+        return 2;
+    }
+
+    return 0;
+}
+
+/**
+ * Whether the token has a separator stuck to something else, e.g.) 'hi;' or 'a&&b', or begins a comment.
+ */
+int __needs_split(char *token) {
+    if (token[0] == COMMENT_KEY) {
+        return 1;
+    }
+
+    return strpbrk(token, ";&|()") != NULL && __separator_length(token) != strlen(token);
+}
+
+/**
+ * Give each separator stuck to other text a token of its own, e.g.) 'a;b&&c' becomes 'a ; b && c', & drop a comment
+ * through to the end of the line. '\;' is left as it is, as an argument, e.g.) for 'find -exec', as is the '()' of a function.
+ *
+ * @returns the tokens, as they were if nothing needed splitting (almost always); NULL if there are none left
+ */
+string_list *__split_separators(string_list *tokens) {
+    string_list *split = NULL;
+    int i;
+
+    for (i = 0; i < tokens->size && __needs_split(tokens->strings[i]) == 0; i++) {
+    }
+
+    if (i == tokens->size) {
+        return tokens;
+    }
+
+    if ((split = string_list_new()) == NULL) {
+        string_list_free(tokens);
+        return NULL;
+    }
+
+    for (i = 0; i < tokens->size && tokens->strings[i][0] != COMMENT_KEY; i++) {
+        char *start = tokens->strings[i];
+        char *at = start;
+
+        while (*at != NULL_CHAR) {
+            size_t len;
+
+            if ((*at == KEYWORD_ESCAPE && at[1] != NULL_CHAR) || strncmp(at, KEYWORD_FUNCTION_PARAMS, strlen(KEYWORD_FUNCTION_PARAMS)) == 0) {
+                at += 2;
+                continue;
+            }
+
+            if ((len = __separator_length(at)) == 0) {
+                at++;
+                continue;
+            }
+
+            if (at > start) {
+                string_list_push_len(split, start, at - start);
+            }
+
+            string_list_push_len(split, at, len);
+            start = at += len;
+        }
+
+        if (*start != NULL_CHAR) {
+            string_list_push(split, start);
+        }
+    }
+
+    string_list_free(tokens);
+
+    if (split->size == 0) {
+        string_list_free(split);
+        return NULL;
+    }
+
+    return split;
+}
+
+/**
+ * Take the next statement off the line being split, up to the ';', '&&', '||' or '&' that ends it.
+ * A '&' stays with its statement, as it's what makes it a background job, & a ')' begins the statement after it.
+ *
+ * @returns the statement's tokens, or NULL if it's empty, e.g.) the space between ';' & ';'
+ */
+string_list *__next_statement(script_reader *reader) {
+    string_list *line = reader->line;
+    int start = reader->line_next;
+    int end = start;
+
+    reader->connector = SCRIPT_RUN_ALWAYS;
+
+    for (; end < line->size; end++) {
+        char *token = line->strings[end];
+
+        if (strcmp(token, KEYWORD_AND) == 0 || strcmp(token, KEYWORD_OR) == 0) {
+            reader->connector = strcmp(token, KEYWORD_AND) == 0 ? SCRIPT_RUN_IF_SUCCESS : SCRIPT_RUN_IF_FAILURE;
+            break;
+        }
+
+        if (strcmp(token, BACKGROUND_KEY) == 0) {
+            reader->line_next = end + 1;
+            return __sub_list(line, start, end + 1);
+        }
+
+        /** '( a; b )' closes the subshell just as '( a; b; )' would */
+        if (end > start && strcmp(token, KEYWORD_PAREN_CLOSE) == 0) {
+            reader->line_next = end;
+            return __sub_list(line, start, end);
+        }
+
+        if (token[0] == KEYWORD_SEPARATOR && token[1] == NULL_CHAR) {
+            break;
+        }
+    }
+
+    reader->line_next = end + 1;
+
+    return __sub_list(line, start, end);
+}
+
+/**
+ * Get the next non-empty statement as tokens, splitting lines into statements as they're read.
+ * Anything left over from a keyword statement is returned first.
+ */
+string_list *__next_line(script_reader *reader) {
+    string_list *tokens = NULL;
+    char *line = NULL;
+
+    if (reader->pending != NULL) {
+        tokens = reader->pending;
+        reader->pending = NULL;
+
+        return tokens;
+    }
+
+    while (1) {
+        while (reader->line != NULL && reader->line_next < reader->line->size) {
+            int joined = reader->connector;
+
+            if ((tokens = __next_statement(reader)) == NULL) {
+                /** nothing between '&&' or '||' & what follows it */
+                if (joined != SCRIPT_RUN_ALWAYS || reader->connector != SCRIPT_RUN_ALWAYS) {
+                    fprintf(stderr, "smash: syntax error: expected a command around '%s'\n",
+                            joined == SCRIPT_RUN_IF_SUCCESS || reader->connector == SCRIPT_RUN_IF_SUCCESS ? KEYWORD_AND : KEYWORD_OR);
+                    reader->error = 1;
+                    return NULL;
+                }
+
+                continue;
+            }
+
+            return tokens;
+        }
+
+        string_list_free(reader->line);
+        reader->line = NULL;
+
+        if ((line = __read_line(reader)) == NULL) {
+            return NULL;
+        }
+
+        debug("script line read: '%s'\n", line);
+
+        session_record_line(line);
+
+        if ((reader->line = parse_command_to_string_list(line)) != NULL) {
+            reader->line = __split_separators(reader->line);
+        }
+
+        reader->line_next = 0;
+        free(line);
+    }
+}
+
+/**
+ * Consume a keyword line; whatever followed the keyword is read next.
+ */
+void __consume_keyword(script_reader *reader, string_list *tokens) {
+    reader->pending = __sub_list(tokens, 1, tokens->size);
+    string_list_free(tokens);
+}
+
+/**
+ * Read the next line and make sure it begins with the keyword.
+ */
+int __expect_keyword(script_reader *reader, char *keyword) {
+    string_list *tokens = NULL;
+
+    if ((tokens = __next_line(reader)) == NULL || strcmp(tokens->strings[0], keyword) != 0) {
+        if (tokens != NULL) {
+            string_list_free(tokens);
+        }
+
+        __syntax_error(reader, keyword);
+        return -1;
+    }
+
+    __consume_keyword(reader, tokens);
+
+    return 0;
+}
+
+script_node *__new_node(int type) {
+    script_node *node = NULL;
+
+    if ((node = malloc(sizeof(script_node))) == NULL) {
+        debug("error: unable to allocate space for script node\n");
+        return NULL;
+    }
+
+    node->type = type;
+    node->command = NULL;
+    node->variable = NULL;
+    node->condition = NULL;
+    node->body = NULL;
+    node->else_body = NULL;
+    node->run_if = SCRIPT_RUN_ALWAYS;
+    node->next = NULL;
+
+    return node;
+}
+
+/**
+ * Parse the rest of a list whose first step is already parsed, e.g.) the 'b || c' of 'a && b || c'.
+ *
+ * @returns the first step alone if there's nothing joined to it, a LIST node of every step otherwise, or NULL on error
+ */
+script_node *__parse_and_or(script_reader *reader, script_node *first) {
+    script_node *list = NULL;
+    script_node *tail = first;
+
+    if (first == NULL || reader->pending != NULL || reader->connector == SCRIPT_RUN_ALWAYS) {
+        return first;
+    }
+
+    if ((list = __new_node(SCRIPT_NODE_LIST)) == NULL) {
+        parse_script_free(first);
+        return NULL;
+    }
+
+    list->body = first;
+
+    while (reader->pending == NULL && reader->connector != SCRIPT_RUN_ALWAYS) {
+        string_list *tokens = NULL;
+        int run_if = reader->connector;
+
+        /** a line ending in '&&' or '||' continues on the next */
+        if ((tokens = __next_line(reader)) == NULL || (tail->next = __parse_node(reader, tokens)) == NULL) {
+            __syntax_error(reader, run_if == SCRIPT_RUN_IF_SUCCESS ? "&& COMMAND" : "|| COMMAND");
+            parse_script_free(list);
+            return NULL;
+        }
+
+        tail = tail->next;
+        tail->run_if = run_if;
+    }
+
+    return list;
+}
+
+/**
+ * Parse the header of an if/elif/while, up to & including the keyword that ends it, e.g.) 'while a && b; do'.
+ *
+ * @returns the condition, or NULL on error
+ */
+script_node *__parse_condition(script_reader *reader, string_list *tokens, char *keyword) {
+    script_node *condition = NULL;
+    string_list *header = __sub_list(tokens, 1, tokens->size);
+
+    string_list_free(tokens);
+
+    if (header == NULL || (condition = __new_node(SCRIPT_NODE_COMMAND)) == NULL) {
+        string_list_free(header);
+        return NULL;
+    }
+
+    condition->command = header;
+
+    if ((condition = __parse_and_or(reader, condition)) == NULL) {
+        return NULL;
+    }
+
+    if (__expect_keyword(reader, keyword) != 0) {
+        parse_script_free(condition);
+        return NULL;
+    }
+
+    return condition;
+}
+
+/**
+ * Parse nodes until a line beginning with one of the terminators is found.
+ *
+ * @returns the head of the parsed list (NULL if empty); *terminator is set to the matching
+ * terminator line's tokens, or to NULL if input ran out first.
+ */
+script_node *__parse_list(script_reader *reader, char **terminators, int num_terminators, string_list **terminator) {
+    script_node *head = NULL;
+    script_node *tail = NULL;
+    string_list *tokens = NULL;
+
+    *terminator = NULL;
+
+    while ((tokens = __next_line(reader)) != NULL) {
+        script_node *node = NULL;
+
+        for (int i = 0; i < num_terminators; i++) {
+            if (strcmp(tokens->strings[0], terminators[i]) == 0) {
+                *terminator = tokens;
+                return head;
+            }
+        }
+
+        if ((node = __parse_and_or(reader, __parse_node(reader, tokens))) == NULL) {
+            parse_script_free(head);
+            return NULL;
+        }
+
+        if (head == NULL) {
+            head = node;
+        } else {
+            tail->next = node;
+        }
+
+        tail = node;
+    }
+
+    return head;
+}
+
+/**
+ * Parse the remainder of an if/elif once its condition tokens are known.
+ */
+script_node *__parse_if(script_reader *reader, string_list *tokens) {
+    char *terminators[] = {KEYWORD_ELIF, KEYWORD_ELSE, KEYWORD_FI};
+    string_list *terminator = NULL;
+    script_node *node = NULL;
+    script_node *condition = NULL;
+
+    if ((condition = __parse_condition(reader, tokens, KEYWORD_THEN)) == NULL) {
+        __syntax_error(reader, "if COMMAND; then");
+        return NULL;
+    }
+
+    if ((node = __new_node(SCRIPT_NODE_IF)) == NULL) {
+        parse_script_free(condition);
+        return NULL;
+    }
+
+    node->condition = condition;
+    node->body = __parse_list(reader, terminators, 3, &terminator);
+
+    if (terminator == NULL) {
+        __syntax_error(reader, KEYWORD_FI);
+        parse_script_free(node);
+        return NULL;
+    }
+
+    if (strcmp(terminator->strings[0], KEYWORD_ELIF) == 0) {
+        /** 'elif' is an if nested in the else branch, which consumes the shared 'fi' */
+        if ((node->else_body = __parse_if(reader, terminator)) == NULL) {
+            parse_script_free(node);
+            return NULL;
+        }
+
+        return node;
+    }
+
+    if (strcmp(terminator->strings[0], KEYWORD_ELSE) == 0) {
+        __consume_keyword(reader, terminator);
+        node->else_body = __parse_list(reader, &KEYWORD_FI, 1, &terminator);
+
+        if (terminator == NULL) {
+            __syntax_error(reader, KEYWORD_FI);
+            parse_script_free(node);
+            return NULL;
+        }
+    }
+
+    __consume_keyword(reader, terminator);
+
+    if (reader->error == 1) {
+        parse_script_free(node);
+        return NULL;
+    }
+
+    return node;
+}
+
+/**
+ * Parse a loop body, up to and including its 'done'.
+ */
+int __parse_loop_body(script_reader *reader, script_node *node) {
+    string_list *terminator = NULL;
+
+    node->body = __parse_list(reader, &KEYWORD_DONE, 1, &terminator);
+
+    if (terminator == NULL) {
+        __syntax_error(reader, KEYWORD_DONE);
+        return -1;
+    }
+
+    __consume_keyword(reader, terminator);
+
+    return reader->error == 1 ? -1 : 0;
+}
+
+script_node *__parse_while(script_reader *reader, string_list *tokens) {
+    script_node *node = NULL;
+    script_node *condition = NULL;
+
+    if ((condition = __parse_condition(reader, tokens, KEYWORD_DO)) == NULL) {
+        __syntax_error(reader, "while COMMAND; do");
+        return NULL;
+    }
+
+    if ((node = __new_node(SCRIPT_NODE_WHILE)) == NULL) {
+        parse_script_free(condition);
+        return NULL;
+    }
+
+    node->condition = condition;
+
+    if (__parse_loop_body(reader, node) != 0) {
+        parse_script_free(node);
+        return NULL;
+    }
+
+    return node;
+}
+
+script_node *__parse_for(script_reader *reader, string_list *tokens) {
+    script_node *node = NULL;
+
+    if (tokens->size < 3 || strcmp(tokens->strings[2], KEYWORD_IN) != 0) {
+        string_list_free(tokens);
+        __syntax_error(reader, "for NAME in ITEMS...");
+        return NULL;
+    }
+
+    if ((node = __new_node(SCRIPT_NODE_FOR)) == NULL || (node->variable = strdup(tokens->strings[1])) == NULL) {
+        string_list_free(tokens);
+        parse_script_free(node);
+        return NULL;
+    }
+
+    /** no items at all is still a valid header */
+    if ((node->command = __sub_list(tokens, 3, tokens->size)) == NULL && tokens->size > 3) {
+        string_list_free(tokens);
+        parse_script_free(node);
+        return NULL;
+    }
+
+    string_list_free(tokens);
+
+    if (__expect_keyword(reader, KEYWORD_DO) != 0) {
+        parse_script_free(node);
+        return NULL;
+    }
+
+    if (__parse_loop_body(reader, node) != 0) {
+        parse_script_free(node);
+        return NULL;
+    }
+
+    return node;
+}
+
+/**
+ * Find whether a line defines a function, as either 'NAME()' or 'NAME ()'.
+ * @returns the index at which its '{' may follow, or 0 when this isn't a function definition
+ */
+int __function_header_length(string_list *tokens) {
+    char *first = tokens->strings[0];
+    size_t params_len = strlen(KEYWORD_FUNCTION_PARAMS);
+
+    if (strlen(first) > params_len && strcmp(first + strlen(first) - params_len, KEYWORD_FUNCTION_PARAMS) == 0) {
+        return 1;
+    }
+
+    if (tokens->size > 1 && strcmp(tokens->strings[1], KEYWORD_FUNCTION_PARAMS) == 0) {
+        return 2;
+    }
+
+    return 0;
+}
+
+script_node *__parse_function(script_reader *reader, string_list *tokens, int brace) {
+    string_list *terminator = NULL;
+    script_node *node = NULL;
+
+    if ((node = __new_node(SCRIPT_NODE_FUNCTION)) == NULL || (node->variable = strdup(tokens->strings[0])) == NULL) {
+        string_list_free(tokens);
+        parse_script_free(node);
+        return NULL;
+    }
+
+    /** drop the '()' from 'NAME()' */
+    if (brace == 1) {
+        node->variable[strlen(node->variable) - strlen(KEYWORD_FUNCTION_PARAMS)] = NULL_CHAR;
+    }
+
+    if (tokens->size > brace) {
+        if (strcmp(tokens->strings[brace], KEYWORD_BRACE_OPEN) != 0) {
+            string_list_free(tokens);
+            __syntax_error(reader, KEYWORD_BRACE_OPEN);
+            parse_script_free(node);
+            return NULL;
+        }
+
+        /** the rest of the line is the first of the body, e.g.) 'f() { echo hi; }' */
+        if ((reader->pending = __sub_list(tokens, brace + 1, tokens->size)) == NULL && tokens->size > brace + 1) {
+            string_list_free(tokens);
+            parse_script_free(node);
+            return NULL;
+        }
+
+        string_list_free(tokens);
+    } else {
+        string_list_free(tokens);
+
+        if (__expect_keyword(reader, KEYWORD_BRACE_OPEN) != 0) {
+            parse_script_free(node);
+            return NULL;
+        }
+    }
+
+    node->body = __parse_list(reader, &KEYWORD_BRACE_CLOSE, 1, &terminator);
+
+    if (terminator == NULL) {
+        __syntax_error(reader, KEYWORD_BRACE_CLOSE);
+        parse_script_free(node);
+        return NULL;
+    }
+
+    __consume_keyword(reader, terminator);
+
+    if (reader->error == 1) {
+        parse_script_free(node);
+        return NULL;
+    }
+
+    return node;
+}
+
+/**
+ * Whether the token is a redirect, e.g.) '>', '2>err' or '<in'.
+ */
+int __is_redirect(char *token) {
+    return strncmp(token, OUTPUT_REDIRECT_KEY, strlen(OUTPUT_REDIRECT_KEY)) == 0 ||
+           strncmp(token, OUTPUT_ERROR_REDIRECT_KEY, strlen(OUTPUT_ERROR_REDIRECT_KEY)) == 0 ||
+           strncmp(token, INPUT_REDIRECT_KEY, strlen(INPUT_REDIRECT_KEY)) == 0;
+}
+
+/**
+ * Parse a '{ ...; }' group or a '( ... )' subshell, through to its closing keyword & any redirects after it.
+ */
+script_node *__parse_group(script_reader *reader, string_list *tokens, int type, char *close) {
+    string_list *terminator = NULL;
+    script_node *node = NULL;
+
+    if ((node = __new_node(type)) == NULL) {
+        string_list_free(tokens);
+        return NULL;
+    }
+
+    __consume_keyword(reader, tokens);
+    node->body = __parse_list(reader, &close, 1, &terminator);
+
+    if (terminator == NULL) {
+        __syntax_error(reader, close);
+        parse_script_free(node);
+        return NULL;
+    }
+
+    /** what follows it may only be redirects, e.g.) '} > out 2> err' */
+    if (terminator->size > 1 && !__is_redirect(terminator->strings[1])) {
+        fprintf(stderr, "smash: syntax error: unexpected '%s' after '%s'\n", terminator->strings[1], close);
+        reader->error = 1;
+    }
+
+    node->command = __sub_list(terminator, 1, terminator->size);
+    string_list_free(terminator);
+
+    if (reader->error == 1) {
+        parse_script_free(node);
+        return NULL;
+    }
+
+    return node;
+}
+
+/**
+ * Parse the node beginning at this line. Takes ownership of the tokens.
+ */
+script_node *__parse_node(script_reader *reader, string_list *tokens) {
+    script_node *node = NULL;
+    char *first = tokens->strings[0];
+    int brace;
+
+    if (strcmp(first, KEYWORD_IF) == 0) {
+        return __parse_if(reader, tokens);
+    }
+
+    if (strcmp(first, KEYWORD_WHILE) == 0) {
+        return __parse_while(reader, tokens);
+    }
+
+    if (strcmp(first, KEYWORD_FOR) == 0) {
+        return __parse_for(reader, tokens);
+    }
+
+    if ((brace = __function_header_length(tokens)) > 0) {
+        return __parse_function(reader, tokens, brace);
+    }
+
+    if (strcmp(first, KEYWORD_BRACE_OPEN) == 0) {
+        return __parse_group(reader, tokens, SCRIPT_NODE_GROUP, KEYWORD_BRACE_CLOSE);
+    }
+
+    if (strcmp(first, KEYWORD_PAREN_OPEN) == 0) {
+        return __parse_group(reader, tokens, SCRIPT_NODE_SUBSHELL, KEYWORD_PAREN_CLOSE);
+    }
+
+    if (strcmp(first, KEYWORD_THEN) == 0 || strcmp(first, KEYWORD_ELIF) == 0 || strcmp(first, KEYWORD_ELSE) == 0 ||
+        strcmp(first, KEYWORD_FI) == 0 || strcmp(first, KEYWORD_DO) == 0 || strcmp(first, KEYWORD_DONE) == 0 ||
+        strcmp(first, KEYWORD_BRACE_CLOSE) == 0 || strcmp(first, KEYWORD_PAREN_CLOSE) == 0) {
+        fprintf(stderr, "smash: syntax error: unexpected '%s'\n", first);
+        reader->error = 1;
+        string_list_free(tokens);
+
+        return NULL;
+    }
+
+    if ((node = __new_node(SCRIPT_NODE_COMMAND)) == NULL) {
+        string_list_free(tokens);
+        return NULL;
+    }
+
+    node->command = tokens;
+
+    return node;
+}
+
+/**
+ * Parse the next complete top-level node; compound commands are read through to their closing keyword.
+ *
+ * @returns NULL at the end of input, or on a syntax error (reader->error is then set).
+ */
+script_node *parse_script_next(script_reader *reader) {
+    string_list *tokens = NULL;
+    script_node *node = NULL;
+
+    if (reader->error == 1 || (tokens = __next_line(reader)) == NULL) {
+        return NULL;
+    }
+
+    node = __parse_and_or(reader, __parse_node(reader, tokens));
+    parse_script_debug(node, 0);
+
+    return node;
+}
+
+/**
+ * Deep copy a parsed list, e.g.) so that a function body outlives the script node that defined it.
+ */
+script_node *parse_script_copy(script_node *node) {
+    script_node *head = NULL;
+    script_node *tail = NULL;
+
+    for (; node != NULL; node = node->next) {
+        script_node *copy = NULL;
+
+        if ((copy = __new_node(node->type)) == NULL) {
+            parse_script_free(head);
+            return NULL;
+        }
+
+        if (node->command != NULL) {
+            copy->command = __sub_list(node->command, 0, node->command->size);
+        }
+
+        if (node->variable != NULL) {
+            copy->variable = strdup(node->variable);
+        }
+
+        copy->run_if = node->run_if;
+        copy->condition = parse_script_copy(node->condition);
+        copy->body = parse_script_copy(node->body);
+        copy->else_body = parse_script_copy(node->else_body);
+
+        if (head == NULL) {
+            head = copy;
+        } else {
+            tail->next = copy;
+        }
+
+        tail = copy;
+    }
+
+    return head;
+}
+
+void parse_script_free(script_node *node) {
+    while (node != NULL) {
+        script_node *next = node->next;
+
+        if (node->command != NULL) {
+            string_list_free(node->command);
+        }
+
+        free(node->variable);
+        parse_script_free(node->condition);
+        parse_script_free(node->body);
+        parse_script_free(node->else_body);
+        free(node);
+
+        node = next;
+    }
+}
+
+/**
+ * Debug print out a parsed tree, indenting nested lists by depth.
+ */
+void parse_script_debug(script_node *node, int depth) {
+    for (; node != NULL; node = node->next) {
+        debug2("%*snode type: %d (run if: %d)\n", depth * 2, "", node->type, node->run_if);
+
+        if (node->variable != NULL) {
+            debug2("%*svariable: '%s'\n", depth * 2, "", node->variable);
+        }
+
+        string_list_debug(node->command);
+
+        if (node->condition != NULL) {
+            debug2("%*scondition:\n", depth * 2, "");
+            parse_script_debug(node->condition, depth + 1);
+        }
+
+        if (node->body != NULL) {
+            debug2("%*sbody:\n", depth * 2, "");
+            parse_script_debug(node->body, depth + 1);
+        }
+
+        if (node->else_body != NULL) {
+            debug2("%*selse:\n", depth * 2, "");
+            parse_script_debug(node->else_body, depth + 1);
+        }
+    }
+}
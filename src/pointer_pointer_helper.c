@@ -99,6 +99,61 @@ char **pointer_pointer_dup(char **array) {
     return allocd;
 }
 
+/**
+ * Count an entry of the block being sized; any of its parts may be NULL.
+ */
+void pointer_pointer_block_size(pointer_pointer_block *block, const char *part1, const char *part2, const char *part3) {
+    const char *parts[] = {part1, part2, part3};
+
+    for (int i = 0; i < 3; i++) {
+        if (parts[i] != NULL) {
+            block->bytes += strlen(parts[i]);
+        }
+    }
+
+    block->bytes++;
+    block->num++;
+}
+
+/**
+ * Allocate the block for the entries sized so far, ready for them to be added.
+ * @returns the array, or NULL if it can't be allocated
+ */
+char **pointer_pointer_block_alloc(pointer_pointer_block *block) {
+    size_t pointers = (block->num + 1) * sizeof(char *);
+
+    if ((block->array = malloc(pointers + block->bytes)) == NULL) {
+        debug("error: unable to allocate space for pointer block\n");
+        return NULL;
+    }
+
+    block->next = (char *)block->array + pointers;
+    block->array[block->num] = NULL;
+    block->num = 0;
+
+    return block->array;
+}
+
+/**
+ * Add the next entry to an allocated block, copying its parts into place.
+ */
+void pointer_pointer_block_add(pointer_pointer_block *block, const char *part1, const char *part2, const char *part3) {
+    const char *parts[] = {part1, part2, part3};
+
+    block->array[block->num++] = block->next;
+
+    for (int i = 0; i < 3; i++) {
+        if (parts[i] != NULL) {
+            size_t len = strlen(parts[i]);
+
+            memcpy(block->next, parts[i], len);
+            block->next += len;
+        }
+    }
+
+    *block->next++ = '\0';
+}
+
 /**
  * Debug prints out the contents of an array, given a specified length
  */
@@ -0,0 +1,202 @@
+#include "prompt.h"
+
+#include "executor.h"
+
+/** the compiled template */
+static char *compiled_template;
+static prompt_segment *segments;
+static int num_segments;
+
+/** rendered output, reused between prompts */
+static char *rendered;
+static size_t rendered_size;
+
+void __prompt_push_segment(int type, char *text, size_t len) {
+    prompt_segment *grown = NULL;
+
+    /** merge adjacent literal text */
+    if (type == PROMPT_SEGMENT_TEXT && num_segments > 0 && segments[num_segments - 1].type == PROMPT_SEGMENT_TEXT) {
+        prompt_segment *last = &segments[num_segments - 1];
+
+        if ((last->text = realloc(last->text, last->len + len + 1)) == NULL) {
+            debug("error: unable to grow prompt text segment\n");
+            return;
+        }
+
+        memcpy(last->text + last->len, text, len);
+        last->len += len;
+        last->text[last->len] = '\0';
+
+        return;
+    }
+
+    if ((grown = realloc(segments, (num_segments + 1) * sizeof(prompt_segment))) == NULL) {
+        debug("error: unable to allocate space for prompt segment\n");
+        return;
+    }
+
+    segments = grown;
+    segments[num_segments].type = type;
+    segments[num_segments].text = type == PROMPT_SEGMENT_TEXT ? strndup(text, len) : NULL;
+    segments[num_segments].len = len;
+    num_segments++;
+}
+
+/**
+ * Compile a template into segments. Escapes whose value can't change during the session are resolved here.
+ */
+void __prompt_compile(char *template) {
+    struct passwd *pw = getpwuid(getuid());
+    char host[256];
+
+    for (int i = 0; i < num_segments; i++) {
+        free(segments[i].text);
+    }
+
+    free(segments);
+    free(compiled_template);
+
+    segments = NULL;
+    num_segments = 0;
+    compiled_template = strdup(template);
+
+    for (char *pos = template; *pos != '\0'; pos++) {
+        if (*pos != '\\' || pos[1] == '\0') {
+            __prompt_push_segment(PROMPT_SEGMENT_TEXT, pos, 1);
+            continue;
+        }
+
+        switch (*++pos) {
+            case 'w':
+                __prompt_push_segment(PROMPT_SEGMENT_CWD, NULL, 0);
+                break;
+            case 'W':
+                __prompt_push_segment(PROMPT_SEGMENT_CWD_BASENAME, NULL, 0);
+                break;
+            case '?':
+                __prompt_push_segment(PROMPT_SEGMENT_EXIT_STATUS, NULL, 0);
+                break;
+            case 'j':
+                __prompt_push_segment(PROMPT_SEGMENT_JOBS, NULL, 0);
+                break;
+            case 't':
+                __prompt_push_segment(PROMPT_SEGMENT_TIME, NULL, 0);
+                break;
+            case 'u':
+                if (pw != NULL) {
+                    __prompt_push_segment(PROMPT_SEGMENT_TEXT, pw->pw_name, strlen(pw->pw_name));
+                }
+                break;
+            case 'h':
+                if (gethostname(host, sizeof(host)) == 0) {
+                    host[sizeof(host) - 1] = '\0';
+                    __prompt_push_segment(PROMPT_SEGMENT_TEXT, host, strcspn(host, "."));
+                }
+                break;
+            case '$':
+                __prompt_push_segment(PROMPT_SEGMENT_TEXT, getuid() == 0 ? "#" : "$", 1);
+                break;
+            case 'n':
+                __prompt_push_segment(PROMPT_SEGMENT_TEXT, "\n", 1);
+                break;
+            default:
+                /** '\\' and unknown escapes are kept as the escaped character */
+                __prompt_push_segment(PROMPT_SEGMENT_TEXT, pos, 1);
+                break;
+        }
+    }
+}
+
+void __prompt_append(size_t *len, char *text, size_t text_len) {
+    if (*len + text_len + 1 > rendered_size) {
+        size_t size = rendered_size == 0 ? 128 : rendered_size;
+        char *grown = NULL;
+
+        while (*len + text_len + 1 > size) {
+            size <<= 1;
+        }
+
+        if ((grown = realloc(rendered, size)) == NULL) {
+            debug("error: unable to grow rendered prompt\n");
+            return;
+        }
+
+        rendered = grown;
+        rendered_size = size;
+    }
+
+    memcpy(rendered + *len, text, text_len);
+    *len += text_len;
+    rendered[*len] = '\0';
+}
+
+/**
+ * @returns the prompt template: $PS1 when set, otherwise the default
+ */
+char *prompt_template() {
+    static char *template;
+
+    free(template);
+
+    if ((template = parse_path_get_env(ENV_PROMPT_KEY)) == NULL) {
+        return PROMPT;
+    }
+
+    return template;
+}
+
+/**
+ * Render the prompt for the given template, compiling it first only if it changed since the last prompt.
+ */
+char *prompt_render(char *template) {
+    char *cwd = NULL;
+    char number[24];
+    size_t len = 0;
+
+    if (compiled_template == NULL || strcmp(compiled_template, template) != 0) {
+        __prompt_compile(template);
+    }
+
+    __prompt_append(&len, "", 0);
+
+    for (int i = 0; i < num_segments; i++) {
+        prompt_segment *segment = &segments[i];
+
+        switch (segment->type) {
+            case PROMPT_SEGMENT_TEXT:
+                __prompt_append(&len, segment->text, segment->len);
+                break;
+            case PROMPT_SEGMENT_CWD:
+                if ((cwd = internal_command_pwd_current()) != NULL) {
+                    __prompt_append(&len, cwd, strlen(cwd));
+                }
+                break;
+            case PROMPT_SEGMENT_CWD_BASENAME:
+                if ((cwd = internal_command_pwd_current()) == NULL) {
+                    break;
+                }
+
+                if (strrchr(cwd, '/') != NULL && strlen(cwd) > 1) {
+                    cwd = strrchr(cwd, '/') + 1;
+                }
+
+                __prompt_append(&len, cwd, strlen(cwd));
+                break;
+            case PROMPT_SEGMENT_EXIT_STATUS:
+                __prompt_append(&len, number, sprintf(number, "%d", get_last_return_value()));
+                break;
+            case PROMPT_SEGMENT_JOBS:
+                __prompt_append(&len, number, sprintf(number, "%d", executor_count_running_jobs()));
+                break;
+            case PROMPT_SEGMENT_TIME: {
+                time_t now = time(NULL);
+                struct tm ts = *localtime(&now);
+
+                __prompt_append(&len, number, strftime(number, sizeof(number), "%H:%M:%S", &ts));
+                break;
+            }
+        }
+    }
+
+    return rendered;
+}
@@ -1,12 +1,24 @@
 #include "readline.h"
 
-static readline_sig_hook *readline_hook;
+static readline_wait_hook *readline_hook;
 
-void readline_set_sig_hook(readline_sig_hook hook) {
+void readline_set_wait_hook(readline_wait_hook hook) {
     readline_hook = hook;
     return;
 }
 
+/**
+ * Wait for input on fd through the hook, which deals with finished jobs in the meantime.
+ * Only stdin is waited on; other fd's are read straight away.
+ */
+int readline_wait(int fd) {
+    if (fd == fileno(stdin) && readline_hook != NULL) {
+        return readline_hook(fd);
+    }
+
+    return 1;
+}
+
 /**
  * Read in text up until a new line character '\n'.
  * Prompts only after waiting for previous job to finish or after waiting a specified amount of time.
@@ -24,66 +36,24 @@ char *readline(char *prompt, int fd) {
 
     char c;
     char *bp = buf;
+    long long trace_start;
 
     if (prompt != NULL) {
-        internal_command_pwd();
-
-        fprintf(stdout, "%s", prompt);
+        fputs(prompt_render(prompt), stdout);
         fflush(stdout);
     }
 
-    while (1) {
-        /**
-         * Mask signal bits
-         */
-        sigset_t mask, out_mask;
-        sigfillset(&mask);
-        sigprocmask(SIG_BLOCK, &mask, &out_mask);
-
-        /**
-         * Call the hook
-         */
-        if (readline_hook != NULL) {
-            readline_hook();
-        }
-
-        /**
-         * Release signals
-         */
-        fd_set fd_in;
-        FD_ZERO(&fd_in);
-        FD_SET(fd, &fd_in);
-
-        int ready_desc;
-        int check_err;
-
-        if (fd == fileno(stdin)) {
-            ready_desc = pselect(1, &fd_in, NULL, NULL, NULL, &out_mask);
-        } else {
-            ready_desc = 1;
-        }
+    /** the span covers the time spent waiting for the line, not drawing the prompt */
+    trace_start = trace_begin();
 
-        check_err = errno;
-
-        /** unmask */
-        sigprocmask(SIG_SETMASK, &out_mask, NULL);
-
-        /**
-         * Check if there are no ready file descriptors; s.t. read would probably fail.
-         */
-        if (ready_desc < 0) {
-            if (check_err == EINTR) {
-                continue;
-            }
-
-            return NULL;
-        } else if (ready_desc == 0) {
+    while (1) {
+        if (readline_wait(fd) < 0) {
             if (bp - buf > 0) {
                 break;
-            } else {
-                free(buf);
-                return NULL;
             }
+
+            free(buf);
+            return NULL;
         }
 
         /**
@@ -107,13 +77,14 @@ char *readline(char *prompt, int fd) {
 
         if (bp - buf >= size - 1) {
             char *new_buf = NULL;
+            long used = bp - buf;
             size <<= 1;
 
             if ((new_buf = realloc(buf, size)) == NULL) {
                 fprintf(stderr, "error: unable to realloc for input buffer\n");
                 break;
             } else {
-                bp = new_buf + (bp - buf);
+                bp = new_buf + used;
                 buf = new_buf;
             }
         }
@@ -125,5 +96,103 @@ char *readline(char *prompt, int fd) {
 
     debug("finsihed reading line\n");
 
+    trace_end(TRACE_READLINE, NULL, trace_start);
+
     return buf;
 }
+
+readline_buffer *readline_buffer_new(int fd) {
+    readline_buffer *in = NULL;
+
+    if ((in = malloc(sizeof(readline_buffer))) == NULL) {
+        debug("error: unable to allocate space for readline buffer\n");
+        return NULL;
+    }
+
+    if ((in->buf = malloc(READLINE_BUFFER_SIZE)) == NULL) {
+        debug("error: unable to allocate space for readline buffer contents\n");
+        free(in);
+        return NULL;
+    }
+
+    in->fd = fd;
+    in->size = READLINE_BUFFER_SIZE;
+    in->start = 0;
+    in->end = 0;
+    in->eof = 0;
+
+    return in;
+}
+
+/**
+ * Read in the next line, without its '\n', from a large buffer of input that's refilled as it runs out.
+ * Waits through the wait hook only when the buffer has to be refilled, so finished jobs are still reaped.
+ *
+ * @returns a new string, or NULL once the input has ended
+ */
+char *readline_buffered(readline_buffer *in) {
+    char *line = NULL;
+    char *newline = NULL;
+    int ret;
+
+    while (1) {
+        if ((newline = memchr(in->buf + in->start, '\n', in->end - in->start)) != NULL) {
+            line = strndup(in->buf + in->start, newline - (in->buf + in->start));
+            in->start = newline - in->buf + 1;
+
+            break;
+        }
+
+        if (in->eof == 1) {
+            /** the last line may be missing its '\n' */
+            if (in->start < in->end) {
+                line = strndup(in->buf + in->start, in->end - in->start);
+                in->start = in->end;
+            }
+
+            break;
+        }
+
+        /** keep the part of a line read so far, & make room for the rest of it */
+        if (in->start > 0) {
+            memmove(in->buf, in->buf + in->start, in->end - in->start);
+            in->end -= in->start;
+            in->start = 0;
+        }
+
+        if (in->end == in->size) {
+            char *new_buf = NULL;
+
+            if ((new_buf = realloc(in->buf, in->size << 1)) == NULL) {
+                fprintf(stderr, "error: unable to realloc for input buffer\n");
+                in->eof = 1;
+                continue;
+            }
+
+            in->buf = new_buf;
+            in->size <<= 1;
+        }
+
+        long long trace_start = trace_begin();
+
+        if (readline_wait(in->fd) < 0) {
+            in->eof = 1;
+            continue;
+        }
+
+        ret = read(in->fd, in->buf + in->end, in->size - in->end);
+        trace_end(TRACE_READLINE, NULL, trace_start);
+
+        if (ret == -1 && errno == EINTR) {
+            continue;
+        }
+
+        if (ret <= 0) {
+            in->eof = 1;
+        } else {
+            in->end += ret;
+        }
+    }
+
+    return line;
+}
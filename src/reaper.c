@@ -0,0 +1,401 @@
+#include "reaper.h"
+
+#include "executor.h"
+
+/** pidfd of every watched job; the epoll data of each is the job's commander */
+static int reaper_epoll = -1;
+
+/** the input fd being read by readline() & reaper_epoll itself */
+static int input_epoll = -1;
+
+/** the fd currently registered in input_epoll, and whether epoll can wait on it at all */
+static int input_fd = -1;
+static int input_pollable = 0;
+
+/** output pipes of background jobs, when SMASH_JOB_OUTPUT is on */
+static int output_epoll = -1;
+
+/**
+ * Create the epoll sets. Must be called before any job is started.
+ */
+int reaper_init() {
+    struct epoll_event event;
+
+    if ((reaper_epoll = epoll_create1(EPOLL_CLOEXEC)) == -1 || (input_epoll = epoll_create1(EPOLL_CLOEXEC)) == -1) {
+        debug("error: unable to create epoll sets: %d\n", errno);
+        return -1;
+    }
+
+    event.events = EPOLLIN;
+    event.data.fd = reaper_epoll;
+
+    if (epoll_ctl(input_epoll, EPOLL_CTL_ADD, reaper_epoll, &event) == -1) {
+        debug("error: unable to nest the reaper epoll set: %d\n", errno);
+        return -1;
+    }
+
+    /** no job has a NULL commander, so that marks the job output set */
+    event.data.ptr = NULL;
+
+    if ((output_epoll = job_output_init()) != -1 && epoll_ctl(reaper_epoll, EPOLL_CTL_ADD, output_epoll, &event) == -1) {
+        debug("error: unable to nest the job output epoll set: %d\n", errno);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * In a forked subshell: start over with epoll sets of its own. The inherited ones are shared with the shell,
+ * which would otherwise be woken for the subshell's jobs, & handed commanders that only exist in the subshell.
+ */
+int reaper_reinit() {
+    close(reaper_epoll);
+    close(input_epoll);
+
+    if (output_epoll != -1) {
+        close(output_epoll);
+    }
+
+    input_fd = -1;
+    input_pollable = 0;
+
+    return reaper_init();
+}
+
+/**
+ * Start watching a newly forked job through a pidfd.
+ * Without pidfd support the job is still reaped, by wait4() in reaper_wait_job() & executor_has_running_jobs().
+ */
+int reaper_watch(commander *cmd) {
+    struct epoll_event event;
+
+    if ((cmd->pidfd = syscall(SYS_pidfd_open, cmd->pid, 0)) == -1) {
+        debug("unable to open pidfd for job %d: %d\n", cmd->job_id, errno);
+        return -1;
+    }
+
+    fcntl(cmd->pidfd, F_SETFD, FD_CLOEXEC);
+
+    event.events = EPOLLIN;
+    event.data.ptr = cmd;
+
+    if (epoll_ctl(reaper_epoll, EPOLL_CTL_ADD, cmd->pidfd, &event) == -1) {
+        debug("unable to watch pidfd of job %d: %d\n", cmd->job_id, errno);
+        close(cmd->pidfd);
+        cmd->pidfd = -1;
+
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Stop watching a job that has been reaped.
+ */
+void reaper_unwatch(commander *cmd) {
+    if (cmd->timerfd != -1) {
+        epoll_ctl(reaper_epoll, EPOLL_CTL_DEL, cmd->timerfd, NULL);
+        close(cmd->timerfd);
+        cmd->timerfd = -1;
+    }
+
+    if (cmd->pidfd == -1) {
+        return;
+    }
+
+    epoll_ctl(reaper_epoll, EPOLL_CTL_DEL, cmd->pidfd, NULL);
+    close(cmd->pidfd);
+    cmd->pidfd = -1;
+}
+
+/**
+ * Parse a duration, e.g.) '10', '1.5s', '500ms', '2m' or '1h'; plain numbers are seconds.
+ *
+ * @returns nanoseconds, or -1 if it's not a duration
+ */
+long long reaper_parse_duration(char *duration) {
+    char *unit = NULL;
+    double value;
+
+    errno = 0;
+    value = strtod(duration, &unit);
+
+    if (unit == duration || errno != 0 || value < 0) {
+        return -1;
+    }
+
+    if (*unit == NULL_CHAR || strcmp(unit, "s") == 0) {
+        return value * 1e9;
+    } else if (strcmp(unit, "ms") == 0) {
+        return value * 1e6;
+    } else if (strcmp(unit, "m") == 0) {
+        return value * 60e9;
+    } else if (strcmp(unit, "h") == 0) {
+        return value * 3600e9;
+    }
+
+    return -1;
+}
+
+/**
+ * The time limit of every job without one of its own, from $SMASH_CMD_TIMEOUT.
+ *
+ * @returns nanoseconds, or 0 for none
+ */
+long long reaper_default_timeout() {
+    char *timeout = NULL;
+    long long timeout_ns;
+
+    if ((timeout = parse_path_get_env(ENV_CMD_TIMEOUT_KEY)) == NULL) {
+        return 0;
+    }
+
+    if (timeout[0] == NULL_CHAR) {
+        timeout_ns = 0;
+    } else if ((timeout_ns = reaper_parse_duration(timeout)) == -1) {
+        fprintf(stderr, "smash: %s: not a duration: '%s'\n", ENV_CMD_TIMEOUT_KEY, timeout);
+        timeout_ns = 0;
+    }
+
+    free(timeout);
+
+    return timeout_ns;
+}
+
+/**
+ * Arm the job's timerfd to go off after the given time.
+ */
+int __reaper_arm(commander *cmd, long long after_ns) {
+    struct itimerspec deadline = {0};
+
+    deadline.it_value.tv_sec = after_ns / 1000000000LL;
+    deadline.it_value.tv_nsec = after_ns % 1000000000LL;
+
+    /** a zero it_value would disarm it instead */
+    if (after_ns <= 0) {
+        deadline.it_value.tv_nsec = 1;
+    }
+
+    return timerfd_settime(cmd->timerfd, 0, &deadline, NULL);
+}
+
+/**
+ * Start the clock on a newly forked job with a time limit. Must be called after reaper_watch().
+ */
+int reaper_set_timeout(commander *cmd) {
+    struct epoll_event event;
+
+    if (cmd->timeout_ns <= 0) {
+        return 0;
+    }
+
+    if ((cmd->timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK)) == -1) {
+        debug("unable to create timerfd for job %d: %d\n", cmd->job_id, errno);
+        return -1;
+    }
+
+    event.events = EPOLLIN;
+    event.data.ptr = cmd;
+
+    if (__reaper_arm(cmd, cmd->timeout_ns) == -1 || epoll_ctl(reaper_epoll, EPOLL_CTL_ADD, cmd->timerfd, &event) == -1) {
+        debug("unable to watch timerfd of job %d: %d\n", cmd->job_id, errno);
+        close(cmd->timerfd);
+        cmd->timerfd = -1;
+
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * If the job's timer has gone off, signal its process group: SIGTERM first, then SIGKILL once the grace period is up.
+ */
+void __reaper_check_timeout(commander *cmd) {
+    uint64_t expirations;
+    int sig;
+
+    if (cmd->timerfd == -1 || read(cmd->timerfd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+        return;
+    }
+
+    sig = cmd->timed_out == 0 ? SIGTERM : SIGKILL;
+    debug("job %d ran out of time, sending signal %d\n", cmd->job_id, sig);
+
+    /** the child may not have made its own process group yet */
+    if (killpg(cmd->pid, sig) == -1) {
+        kill(cmd->pid, sig);
+    }
+
+    if (cmd->timed_out == 0) {
+        cmd->timed_out = 1;
+        __reaper_arm(cmd, cmd->kill_after_ns > 0 ? cmd->kill_after_ns : REAPER_KILL_AFTER_NS);
+    }
+}
+
+/**
+ * Reap each job whose pidfd became readable.
+ */
+void __reaper_dispatch(struct epoll_event *events, int num_events) {
+    for (int i = 0; i < num_events; i++) {
+        commander *cmd = events[i].data.ptr;
+        struct rusage usage;
+        int status;
+
+        if (cmd == NULL) {
+            job_output_drain();
+            continue;
+        }
+
+        if (cmd->running != 1) {
+            continue;
+        }
+
+        __reaper_check_timeout(cmd);
+
+        if (wait4(cmd->pid, &status, WNOHANG, &usage) > 0) {
+            executor_job_done(cmd, status, &usage);
+        }
+    }
+}
+
+/**
+ * Wait on the reaper's epoll set, reaping whatever finished.
+ *
+ * @returns the number of events handled, or -1 on error
+ */
+int __reaper_wait(int timeout) {
+    struct epoll_event events[REAPER_MAX_EVENTS];
+    int num_events;
+
+    while ((num_events = epoll_wait(reaper_epoll, events, REAPER_MAX_EVENTS, timeout)) == -1 && errno == EINTR)
+        ;
+
+    if (num_events > 0) {
+        __reaper_dispatch(events, num_events);
+    }
+
+    return num_events;
+}
+
+/**
+ * Reap any jobs that have finished, without blocking.
+ */
+int reaper_poll() {
+    int num_events;
+    int total = 0;
+
+    while ((num_events = __reaper_wait(0)) > 0) {
+        total += num_events;
+    }
+
+    return num_events == -1 ? -1 : total;
+}
+
+/**
+ * Block until the job has been reaped, reaping any others that finish in the meantime.
+ */
+int reaper_wait_job(commander *cmd) {
+    struct rusage usage;
+    long long trace_start = trace_begin();
+    int status;
+    pid_t wpid;
+
+    while (cmd->running == 1 && cmd->pidfd != -1) {
+        if (__reaper_wait(-1) == -1) {
+            debug("error: unable to wait on reaper epoll set: %d\n", errno);
+            break;
+        }
+    }
+
+    /** not watched through a pidfd - fall back to waiting on the pid itself */
+    if (cmd->running == 1) {
+        while ((wpid = wait4(cmd->pid, &status, 0, &usage)) == -1 && errno == EINTR)
+            ;
+
+        if (wpid == -1) {
+            debug("error: unable to wait for job: %d\n", cmd->job_id);
+            return -1;
+        }
+
+        executor_job_done(cmd, status, &usage);
+    }
+
+    trace_end(TRACE_WAIT, cmd->bin, trace_start);
+
+    return cmd->exit_code;
+}
+
+/**
+ * Block until at least one watched job has been reaped.
+ *
+ * @returns the number of events handled, or -1 on error
+ */
+int reaper_wait_any() {
+    int num_events;
+
+    while ((num_events = __reaper_wait(-1)) == 0)
+        ;
+
+    if (num_events == -1) {
+        debug("error: unable to wait on reaper epoll set: %d\n", errno);
+    }
+
+    return num_events;
+}
+
+/**
+ * Block until the fd has input to read, reaping jobs as they finish in the meantime.
+ * Used as readline()'s wait hook.
+ *
+ * @returns 1 once the fd is readable, or -1 on error
+ */
+int reaper_wait_readable(int fd) {
+    struct epoll_event events[2];
+    struct epoll_event event;
+    int num_events;
+
+    if (fd != input_fd) {
+        if (input_fd != -1 && input_pollable == 1) {
+            epoll_ctl(input_epoll, EPOLL_CTL_DEL, input_fd, NULL);
+        }
+
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+
+        input_fd = fd;
+        input_pollable = epoll_ctl(input_epoll, EPOLL_CTL_ADD, fd, &event) == 0;
+    }
+
+    /** regular files can't be waited on (and are always ready) */
+    if (input_pollable == 0) {
+        reaper_poll();
+        return 1;
+    }
+
+    while (1) {
+        int ready = 0;
+
+        if ((num_events = epoll_wait(input_epoll, events, 2, -1)) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return -1;
+        }
+
+        for (int i = 0; i < num_events; i++) {
+            if (events[i].data.fd == reaper_epoll) {
+                reaper_poll();
+            } else {
+                ready = 1;
+            }
+        }
+
+        if (ready == 1) {
+            return 1;
+        }
+    }
+}
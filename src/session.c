@@ -0,0 +1,305 @@
+#include "session.h"
+
+static int record_fd = -1;
+
+/** when the recorded session began */
+static long long record_started_us;
+
+/** the working directory last written to the recording */
+static char *record_cwd;
+
+long long __session_now_us(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+/**
+ * Escape '\' & newlines, so that every entry stays on a line of its own.
+ * @returns a new string
+ */
+char *__session_escape(char *str) {
+    char *escaped = NULL;
+    int len = 0;
+
+    if ((escaped = malloc(2 * strlen(str) + 1)) == NULL) {
+        return NULL;
+    }
+
+    for (char *c = str; *c != '\0'; c++) {
+        if (*c == '\\' || *c == '\n') {
+            escaped[len++] = '\\';
+            escaped[len++] = *c == '\n' ? 'n' : '\\';
+        } else {
+            escaped[len++] = *c;
+        }
+    }
+
+    escaped[len] = '\0';
+
+    return escaped;
+}
+
+/**
+ * Undo __session_escape(), in place.
+ */
+void __session_unescape(char *str) {
+    char *out = str;
+
+    for (char *c = str; *c != '\0'; c++) {
+        if (*c == '\\' && (c[1] == 'n' || c[1] == '\\')) {
+            *out++ = *++c == 'n' ? '\n' : '\\';
+        } else {
+            *out++ = *c;
+        }
+    }
+
+    *out = '\0';
+}
+
+/**
+ * Write an entry, e.g.) 'env ' & 'HOME=/root', as a single write.
+ */
+void __session_record_entry(char *type, char *value) {
+    char *escaped = NULL;
+    char *entry = NULL;
+    int len;
+
+    if ((escaped = __session_escape(value)) == NULL) {
+        return;
+    }
+
+    if ((entry = malloc(strlen(type) + strlen(escaped) + 2)) == NULL) {
+        free(escaped);
+        return;
+    }
+
+    len = sprintf(entry, "%s%s\n", type, escaped);
+
+    if (write(record_fd, entry, len) != len) {
+        debug("error: short write of session entry\n");
+    }
+
+    free(entry);
+    free(escaped);
+}
+
+/**
+ * Record a cwd entry if the working directory has changed since the last one.
+ */
+void __session_record_cwd(void) {
+    char *cwd = internal_command_pwd_current();
+
+    if (cwd == NULL || (record_cwd != NULL && strcmp(cwd, record_cwd) == 0)) {
+        return;
+    }
+
+    free(record_cwd);
+    record_cwd = strdup(cwd);
+
+    __session_record_entry(SESSION_ENTRY_CWD, cwd);
+}
+
+/**
+ * Start recording the session to the file at path, beginning with the working directory & environment.
+ */
+int session_record_open(char *path) {
+    /** only readable by the user, like the history file, as the environment it records may well hold secrets */
+    if ((record_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600)) == -1 || fchmod(record_fd, 0600) == -1) {
+        return -1;
+    }
+
+    record_started_us = __session_now_us();
+
+    if (write(record_fd, SESSION_MAGIC "\n", strlen(SESSION_MAGIC) + 1) != strlen(SESSION_MAGIC) + 1) {
+        return -1;
+    }
+
+    __session_record_cwd();
+
+    for (char **env = parse_path_envp(); env != NULL && *env != NULL; env++) {
+        __session_record_entry(SESSION_ENTRY_ENV, *env);
+    }
+
+    return 0;
+}
+
+/**
+ * Record an input line, along with when it was entered. Does nothing unless recording.
+ */
+void session_record_line(char *line) {
+    char offset[32];
+
+    if (record_fd == -1) {
+        return;
+    }
+
+    __session_record_cwd();
+
+    sprintf(offset, "%s%lld ", SESSION_ENTRY_LINE, __session_now_us() - record_started_us);
+    __session_record_entry(offset, line);
+}
+
+/**
+ * Read the next entry, without its newline, & unescape it.
+ *
+ * @returns 0, or -1 at the end of the recording
+ */
+int __session_replay_read(session_replay *replay) {
+    ssize_t len;
+
+    if ((len = getline(&replay->entry, &replay->entry_size, replay->file)) == -1) {
+        return -1;
+    }
+
+    if (len > 0 && replay->entry[len - 1] == '\n') {
+        replay->entry[len - 1] = '\0';
+    }
+
+    __session_unescape(replay->entry);
+    replay->pending = 1;
+
+    return 0;
+}
+
+/**
+ * Open a recording & read its header: the working directory & environment to start the replay with.
+ *
+ * @returns NULL if it can't be read or isn't a recording
+ */
+session_replay *session_replay_open(char *path, int paced) {
+    session_replay *replay = NULL;
+
+    if ((replay = calloc(1, sizeof(session_replay))) == NULL) {
+        debug("error: unable to allocate space for session replay\n");
+        return NULL;
+    }
+
+    replay->paced = paced;
+
+    if ((replay->env = malloc(sizeof(char *))) == NULL || (replay->file = fopen(path, "r")) == NULL) {
+        free(replay->env);
+        free(replay);
+        return NULL;
+    }
+
+    replay->env[0] = NULL;
+
+    if (__session_replay_read(replay) != 0 || strcmp(replay->entry, SESSION_MAGIC) != 0) {
+        fprintf(stderr, "smash: error - '%s' is not a recorded session\n", path);
+        return NULL;
+    }
+
+    replay->pending = 0;
+
+    while (__session_replay_read(replay) == 0) {
+        if (strncmp(replay->entry, SESSION_ENTRY_CWD, strlen(SESSION_ENTRY_CWD)) == 0) {
+            free(replay->cwd);
+            replay->cwd = strdup(replay->entry + strlen(SESSION_ENTRY_CWD));
+        } else if (strncmp(replay->entry, SESSION_ENTRY_ENV, strlen(SESSION_ENTRY_ENV)) == 0) {
+            if ((replay->env = realloc(replay->env, (replay->env_len + 2) * sizeof(char *))) == NULL) {
+                debug("error: unable to reallocate space for replay env\n");
+                return NULL;
+            }
+
+            replay->env[replay->env_len++] = strdup(replay->entry + strlen(SESSION_ENTRY_ENV));
+            replay->env[replay->env_len] = NULL;
+        } else {
+            /** the first line; the header's done */
+            break;
+        }
+
+        replay->pending = 0;
+    }
+
+    return replay;
+}
+
+/**
+ * Wait until the line is due, by the time it was entered in the recording.
+ */
+void __session_replay_pace(session_replay *replay) {
+    long long wait_us = replay->recorded_us - (__session_now_us() - replay->started_us);
+    struct timespec ts;
+
+    if (!replay->paced || wait_us <= 0) {
+        return;
+    }
+
+    ts.tv_sec = wait_us / 1000000;
+    ts.tv_nsec = (wait_us % 1000000) * 1000;
+
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR)
+        ;
+}
+
+/**
+ * Get the next recorded input line; a script_reader's line source.
+ * Where the recording has the working directory changing, it's checked that the replay changed it the same way.
+ *
+ * @returns a new string, or NULL at the end of the recording
+ */
+char *session_replay_next(void *data) {
+    session_replay *replay = data;
+    char *text = NULL;
+
+    if (replay->started_us == 0) {
+        replay->started_us = __session_now_us();
+    }
+
+    while (replay->pending == 1 || __session_replay_read(replay) == 0) {
+        replay->pending = 0;
+
+        if (strncmp(replay->entry, SESSION_ENTRY_CWD, strlen(SESSION_ENTRY_CWD)) == 0) {
+            char *cwd = internal_command_pwd_current();
+
+            if (cwd == NULL || strcmp(cwd, replay->entry + strlen(SESSION_ENTRY_CWD)) != 0) {
+                debug("replay is in '%s', recording was in '%s'\n", cwd, replay->entry + strlen(SESSION_ENTRY_CWD));
+                replay->cwd_mismatches++;
+            }
+
+            continue;
+        }
+
+        if (strncmp(replay->entry, SESSION_ENTRY_LINE, strlen(SESSION_ENTRY_LINE)) != 0) {
+            debug("skipping unknown session entry: '%s'\n", replay->entry);
+            continue;
+        }
+
+        replay->recorded_us = strtoll(replay->entry + strlen(SESSION_ENTRY_LINE), &text, 10);
+
+        if (*text == ' ') {
+            text++;
+        }
+
+        __session_replay_pace(replay);
+        replay->lines++;
+
+        return strdup(text);
+    }
+
+    return NULL;
+}
+
+/**
+ * Print how long the replay took, against how long the recorded session did.
+ */
+void session_replay_report(session_replay *replay) {
+    long long elapsed_us = replay->started_us == 0 ? 0 : __session_now_us() - replay->started_us;
+    double elapsed = elapsed_us / 1000000.0;
+
+    fprintf(stderr, "smash: replayed %d lines in %.3fs", replay->lines, elapsed);
+
+    if (elapsed_us > 0) {
+        fprintf(stderr, " (%.1f lines/s, %.3fms/line)", replay->lines / elapsed,
+                replay->lines > 0 ? elapsed_us / 1000.0 / replay->lines : 0.0);
+    }
+
+    fprintf(stderr, "; recorded session took %.3fs%s\n", replay->recorded_us / 1000000.0, replay->paced ? ", paced" : "");
+
+    if (replay->cwd_mismatches > 0) {
+        fprintf(stderr, "smash: working directory differed from the recording %d times\n", replay->cwd_mismatches);
+    }
+}
@@ -1,24 +1,30 @@
 #include "string_list.h"
 
 /**
- * Creates a new string_list. 
- * NOTE: The string at the initial index must be allocated. and the string must then be copied over.
- * 
- * @return a new string list array with length 1
+ * Creates a new, empty string_list.
+ *
+ * @return a new string list, with room for a few strings before it has to grow
  */
 string_list *string_list_new() {
     string_list *n_string_list = NULL;
-    int initial_size = 1;
 
     if ((n_string_list = malloc(sizeof(string_list))) == NULL) {
         debug("error: unable to allocate space for n_string_list\n");
         return NULL;
     }
 
-    n_string_list->size = initial_size;
+    n_string_list->size = 0;
+    n_string_list->capacity = STRING_LIST_INITIAL_CAPACITY;
+    n_string_list->chars_used = 0;
+    n_string_list->chars_capacity = STRING_LIST_INITIAL_CHARS;
 
-    if ((n_string_list->strings = malloc(initial_size * sizeof(char *))) == NULL) {
+    n_string_list->strings = malloc(n_string_list->capacity * sizeof(char *));
+    n_string_list->offsets = malloc(n_string_list->capacity * sizeof(size_t));
+    n_string_list->chars = malloc(n_string_list->chars_capacity);
+
+    if (n_string_list->strings == NULL || n_string_list->offsets == NULL || n_string_list->chars == NULL) {
         debug("error: unable to allocate space for string list strings\n");
+        string_list_free(n_string_list);
         return NULL;
     }
 
@@ -26,136 +32,202 @@ string_list *string_list_new() {
 }
 
 /**
- * Directly insert & allocate space for a string at a specified index.
- * 
- * Assumes that the index has been already pre-allocated. 
+ * Creates a new string list - but unlike the above function,
+ * this one takes in a string as a paramter and initializes the first value of the string list with the specified string.
  */
-int string_list_direct_insert(string_list *list, int index, char *string) {
-    if ((list->strings[index] = malloc(strlen(string) + 1)) == NULL) {
-        debug("error: unable to allocate space for list strings indices\n");
-        return -1;
-    }
+string_list *string_list_from(char *string) {
+    string_list *list = NULL;
 
-    /** initialize memory */
-    memset(list->strings[index], 0, strlen(string) + 1);
+    if ((list = string_list_new()) == NULL) {
+        return NULL;
+    }
 
-    /** copy over contents of string */
-    debug2("the string i'm direct inserting is: '%s', at index: %d\n", string, index);
-    memcpy(list->strings[index], string, strlen(string) + 1);
+    string_list_push(list, string);
 
-    return 0;
+    return list;
 }
 
 /**
- * Creates a new string list - but unlike the above function, 
- * this one takes in a string as a paramter and initializes the first value of the string list with the specified string.
+ * Grow the buffer to hold at least the given number of bytes, re-pointing the strings into its new place.
  */
-string_list *string_list_from(char *string) {
-    string_list *list = NULL;
+int __string_list_reserve_chars(string_list *list, size_t needed) {
+    size_t capacity = list->chars_capacity;
+    char *chars = NULL;
 
-    if ((list = string_list_new()) == NULL) {
-        return NULL;
+    if (needed <= capacity) {
+        return 0;
     }
 
-    if (string_list_direct_insert(list, 0, string) != 0) {
-        return NULL;
+    while (capacity < needed) {
+        capacity *= 2;
     }
 
-    return list;
+    if ((chars = realloc(list->chars, capacity)) == NULL) {
+        fprintf(stderr, "error: unable to enlarge string_list with push().\n");
+        return -1;
+    }
+
+    list->chars = chars;
+    list->chars_capacity = capacity;
+
+    for (int i = 0; i < list->size; i++) {
+        list->strings[i] = list->chars + list->offsets[i];
+    }
+
+    return 0;
 }
 
 /**
- * Push a single new string obj to the list.
- * The argument string can be de-allocated (free'd) b/c this function makes a copy of it.
+ * Push a copy of the first len bytes of string to the list. The string may be one of the list's own.
  */
-void string_list_push(string_list *list, char *string) {
-    int new_size = list->size + 1;
-    char **new_alloc = NULL;
+void string_list_push_len(string_list *list, const char *string, size_t len) {
+    size_t own = 0;
+    int is_own = string >= list->chars && string < list->chars + list->chars_used;
+
+    if (list->size == list->capacity) {
+        int capacity = list->capacity * 2;
+        char **strings = NULL;
+        size_t *offsets = NULL;
+
+        if ((strings = realloc(list->strings, capacity * sizeof(char *))) == NULL) {
+            fprintf(stderr, "error: unable to enlarge string_list with push().\n");
+            return;
+        }
 
-    debug2("growing stringlist to size: %d\n", new_size);
+        list->strings = strings;
 
-    /** resize the old size list size */
-    if ((new_alloc = realloc(list->strings, new_size * sizeof(char *))) == NULL) {
-        fprintf(stderr, "error: unable to reallocate space for new_alloc\n");
-        return;
+        if ((offsets = realloc(list->offsets, capacity * sizeof(size_t))) == NULL) {
+            fprintf(stderr, "error: unable to enlarge string_list with push().\n");
+            return;
+        }
+
+        list->offsets = offsets;
+        list->capacity = capacity;
     }
 
-    if (new_alloc == NULL) {
-        fprintf(stderr, "error: unable to enlarge string_list with push().\n");
+    /** the buffer may move, so remember where in it a string of its own was */
+    if (is_own) {
+        own = string - list->chars;
+    }
+
+    if (__string_list_reserve_chars(list, list->chars_used + len + 1) != 0) {
         return;
     }
 
-    list->strings = new_alloc;
+    if (is_own) {
+        string = list->chars + own;
+    }
+
+    memcpy(list->chars + list->chars_used, string, len);
+    list->chars[list->chars_used + len] = '\0';
+
+    list->offsets[list->size] = list->chars_used;
+    list->strings[list->size] = list->chars + list->chars_used;
+    list->chars_used += len + 1;
     list->size++;
+}
+
+/**
+ * Push a single new string obj to the list.
+ * The argument string can be de-allocated (free'd) b/c this function makes a copy of it.
+ */
+void string_list_push(string_list *list, char *string) {
+    debug2("about to insert string: '%s', at index: %d\n", string, list->size);
 
-    debug2("about to insert string: '%s', at index: %d\n", string, list->size - 1);
+    string_list_push_len(list, string, strlen(string));
+}
 
-    if (string_list_direct_insert(list, list->size - 1, string) != 0) {
+/**
+ * Remove the last string from the list.
+ */
+void string_list_pop(string_list *list) {
+    if (list->size == 0) {
         return;
     }
 
-    debug2("after insertion, string is: '%s'\n", list->strings[list->size - 1]);
-
-    return;
+    list->size--;
+    list->chars_used = list->offsets[list->size];
 }
 
 /**
- * String list from a specified delimited
+ * String list of the tokens of string, split on any of the delimiter characters. The string isn't modified.
+ *
+ * @returns NULL if there are no tokens
  */
 string_list *string_list_from_delim(char *string, char *delim) {
     string_list *list = NULL;
-    char *token = NULL;
-
-    if ((token = strtok(string, delim)) == NULL) {
-        return NULL;
-    }
 
     debug("String list from delimiter; string: '%s', delimited: '%s'.\n", string, delim);
 
-    if ((list = string_list_from(token)) == NULL) {
+    string += strspn(string, delim);
+
+    if (*string == '\0' || (list = string_list_new()) == NULL) {
         return NULL;
     }
 
-    while (token != NULL) {
-        debug("the parsed token is: %s\n", token);
+    while (*string != '\0') {
+        size_t len = strcspn(string, delim);
 
-        if ((token = strtok(NULL, delim)) == NULL) {
-            break;
-        }
+        string_list_push_len(list, string, len);
+        debug("the parsed token is: %s\n", list->strings[list->size - 1]);
 
-        string_list_push(list, token);
+        string += len;
+        string += strspn(string, delim);
     }
 
     return list;
 }
 
+/**
+ * Join the strings with a space between each, in a single pass over them once the length is known.
+ *
+ * @returns a new string
+ */
 char *string_list_string(string_list *list) {
+    size_t len = 0;
     char *str = NULL;
-    int pos = 0;
+    char *at = NULL;
 
-    if ((str = malloc(1)) == NULL) {
+    for (int i = 0; i < list->size; i++) {
+        len += strlen(list->strings[i]) + 1;
+    }
+
+    if ((str = malloc(len > 0 ? len : 1)) == NULL) {
+        debug("error: unable to allocate space for string list string");
         return NULL;
     }
 
-    for (int i = 0; i < list->size; ++i) {
-        pos = strlen(str);
+    at = str;
+    *at = '\0';
 
-        if ((str = realloc(str, (strlen(str) + strlen(list->strings[i]) + 1))) == NULL) {
-            debug("error: unable to allocate space for string list string");
-            return NULL;
-        }
+    for (int i = 0; i < list->size; i++) {
+        size_t part = strlen(list->strings[i]);
 
-        if (pos != 0) {
-            str[pos] = ' ';
-            pos++;
+        if (i > 0) {
+            *at++ = ' ';
         }
 
-        memcpy(&(str[pos]), list->strings[i], strlen(list->strings[i]) + 1);
+        memcpy(at, list->strings[i], part + 1);
+        at += part;
     }
 
     return str;
 }
 
+/**
+ * Free the string list along with every string it holds.
+ */
+void string_list_free(string_list *list) {
+    if (list == NULL) {
+        return;
+    }
+
+    free(list->strings);
+    free(list->offsets);
+    free(list->chars);
+    free(list);
+}
+
 /**
  * Debug-Print out the contents of the string_list data struct and all of the strings stored in its array.
  */
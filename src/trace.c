@@ -0,0 +1,203 @@
+#include "trace.h"
+
+static int trace_fd = -1;
+
+/** only the shell itself buffers events; a forked child writes its own straight to the file */
+static pid_t trace_owner = -1;
+
+static char trace_buffer[TRACE_BUFFER_SIZE];
+static int trace_used = 0;
+
+/** longest event written, including its (possibly cut short) detail */
+#define TRACE_EVENT_SIZE 1024
+
+void __trace_write(int fd, const char *str, int len) {
+    int written = 0;
+
+    while (written < len) {
+        int ret = write(fd, str + written, len - written);
+
+        if (ret <= 0) {
+            debug("error: unable to write trace: %d\n", ret);
+            return;
+        }
+
+        written += ret;
+    }
+}
+
+/**
+ * Write out whatever is buffered.
+ */
+void trace_flush(void) {
+    if (trace_fd == -1 || getpid() != trace_owner) {
+        return;
+    }
+
+    __trace_write(trace_fd, trace_buffer, trace_used);
+    trace_used = 0;
+}
+
+/**
+ * Flush & close the JSON array. A trace cut short (e.g. by exec) is still readable without it.
+ */
+void __trace_close(void) {
+    if (trace_fd == -1 || getpid() != trace_owner) {
+        return;
+    }
+
+    trace_flush();
+    __trace_write(trace_fd, "\n]\n", 3);
+}
+
+/**
+ * Every event but the first (written by trace_open()) starts with the comma separating it from the one before,
+ * so that each can be written on its own, in a single write.
+ */
+void __trace_event(char *event, int len) {
+    if (len >= TRACE_EVENT_SIZE) {
+        len = TRACE_EVENT_SIZE - 1;
+    }
+
+    if (getpid() != trace_owner) {
+        __trace_write(trace_fd, event, len);
+        return;
+    }
+
+    if (trace_used + len > TRACE_BUFFER_SIZE) {
+        trace_flush();
+    }
+
+    memcpy(trace_buffer + trace_used, event, len);
+    trace_used += len;
+}
+
+/**
+ * Copy str into dest as the inside of a JSON string, stopping short of size.
+ *
+ * @returns the length written
+ */
+int __trace_escape(char *dest, int size, char *str) {
+    int len = 0;
+
+    for (char *c = str; *c != '\0' && len < size - 7; c++) {
+        if (*c == '"' || *c == '\\') {
+            dest[len++] = '\\';
+            dest[len++] = *c;
+        } else if ((unsigned char)*c < 0x20) {
+            len += sprintf(dest + len, "\\u%04x", *c);
+        } else {
+            dest[len++] = *c;
+        }
+    }
+
+    dest[len] = '\0';
+
+    return len;
+}
+
+/**
+ * Start writing the timeline to the file at path, replacing what was there.
+ */
+int trace_open(char *path) {
+    char event[TRACE_EVENT_SIZE];
+    int len;
+
+    if ((trace_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644)) == -1) {
+        return -1;
+    }
+
+    trace_owner = getpid();
+
+    len = snprintf(event, sizeof(event),
+                   "[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"smash\"}}", trace_owner,
+                   trace_owner);
+    __trace_write(trace_fd, event, len);
+
+    trace_track(trace_owner, "shell");
+
+    atexit(__trace_close);
+
+    return 0;
+}
+
+int trace_enabled(void) {
+    return trace_fd != -1;
+}
+
+/**
+ * Monotonic time in nanoseconds, to pass on as the start of a span; 0 when tracing is off.
+ */
+long long trace_begin(void) {
+    struct timespec ts;
+
+    if (trace_fd == -1) {
+        return 0;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * The track of the shell itself.
+ */
+int trace_shell_track(void) {
+    return trace_owner;
+}
+
+/**
+ * Name a track, e.g. a job's after its command line.
+ */
+void trace_track(int track, char *name) {
+    char event[TRACE_EVENT_SIZE];
+    char escaped[TRACE_EVENT_SIZE / 2];
+    int len;
+
+    if (trace_fd == -1) {
+        return;
+    }
+
+    __trace_escape(escaped, sizeof(escaped), name);
+
+    len = snprintf(event, sizeof(event),
+                   ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", trace_owner, track,
+                   escaped);
+    __trace_event(event, len);
+}
+
+/**
+ * Add a span on the track, from begin (as returned by trace_begin()) until now. detail may be NULL.
+ */
+void trace_span(int track, char *name, char *detail, long long begin) {
+    char event[TRACE_EVENT_SIZE];
+    char escaped[TRACE_EVENT_SIZE / 2];
+    long long end;
+    int len;
+
+    if (trace_fd == -1 || begin == 0) {
+        return;
+    }
+
+    end = trace_begin();
+
+    len = snprintf(event, sizeof(event), ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%lld.%03lld,\"dur\":%lld.%03lld",
+                   name, trace_owner, track, begin / 1000, begin % 1000, (end - begin) / 1000, (end - begin) % 1000);
+
+    if (detail != NULL) {
+        __trace_escape(escaped, sizeof(escaped), detail);
+        len += snprintf(event + len, sizeof(event) - len, ",\"args\":{\"detail\":\"%s\"}", escaped);
+    }
+
+    len += snprintf(event + len, sizeof(event) - len, "}");
+
+    __trace_event(event, len);
+}
+
+/**
+ * Add a span on the shell's track, from begin until now.
+ */
+void trace_end(char *name, char *detail, long long begin) {
+    trace_span(trace_owner, name, detail, begin);
+}
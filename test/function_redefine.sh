@@ -0,0 +1,14 @@
+#!/bin/sh
+# A function that redefines itself keeps running its old body to the end; the new body runs on the next call.
+
+out=$(./smash -c 'f() { f() { echo new; }; echo old; }
+f
+f')
+
+if [ "$out" != "$(printf 'old\nnew')" ]; then
+    echo "function_redefine: FAIL, got:"
+    echo "$out"
+    exit 1
+fi
+
+echo "function_redefine: ok"
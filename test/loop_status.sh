@@ -0,0 +1,20 @@
+#!/bin/sh
+# A loop's status is that of its body's last command, or 0 if the body never ran; never that of the condition ending it.
+
+stop=$(mktemp -u)
+
+out=$(./smash -c "while test ! -e $stop; do touch $stop; done && echo while
+while false; do echo never; done && echo empty
+for x in a; do false; done || echo for
+for x in a b; do break; done && echo break")
+status=$?
+
+rm -f "$stop"
+
+if [ "$out" != "$(printf 'while\nempty\nfor\nbreak')" ] || [ $status -ne 0 ]; then
+    echo "loop_status: FAIL, got ($status):"
+    echo "$out"
+    exit 1
+fi
+
+echo "loop_status: ok"